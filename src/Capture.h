@@ -1,7 +1,52 @@
+#include <atomic>
+
 namespace Capture
 {
+  struct Frame
+  {
+    unsigned char * pData; // w * h * 4 bytes of 0xAABBGGRR data, top row first
+    int nWidth;
+    int nHeight;
+    size_t nCapacity;
+    std::atomic<int> nRefCount;
+  };
+
+  // Page-aligned frame buffers shared by the capture system and the sinks;
+  // AcquireFrame() returns NULL (and reports it) when the pool is exhausted.
+  bool OpenFramePool( int nWidth, int nHeight, int nDepth, bool bHugePages );
+  void SetFramePoolSize( int nWidth, int nHeight );
+  Frame * AcquireFrame(); // safe from any thread, returns the frame with a refcount of 1
+  void ReleaseFrame( Frame * frame );
+  void CloseFramePool();
+
+  // A sink receives grabbed frames on its own worker thread, so a slow
+  // sink (network, disk, encoder) never stalls the render loop; if it can't
+  // keep up, frames get dropped for that sink only.
+  class Sink
+  {
+  public:
+    virtual ~Sink() {}
+
+    virtual bool LoadSettings( jsonxx::Object & o ) = 0; // returns true if the sink is enabled
+    virtual bool Open( RENDERER_SETTINGS & settings ) = 0;
+    virtual void SendFrame( const Frame * frame ) = 0; // called on the sink's worker thread
+    virtual int GetHeldFrameCount() { return 1; } // pool buffers the sink may keep between SendFrame() calls, for the default pool size
+    virtual void Close() = 0;
+  };
+
+  typedef Sink * (*SINK_FACTORY)();
+  void RegisterSink( const char * szName, SINK_FACTORY factory );
+
   void LoadSettings(jsonxx::Object & o);
   bool Open(RENDERER_SETTINGS & settings);
   void CaptureFrame();
   void Close();
-}
\ No newline at end of file
+
+  Sink * CreateRawVideoSink();
+#ifdef __linux__
+  Sink * CreateSharedMemorySink();
+#endif
+#ifdef BONZOMATIC_ENABLE_NDI
+  Sink * CreateNDISink();
+#endif
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "Renderer.h"
+#include "Compositor.h"
+
+namespace Compositor
+{
+  // written against the from() / to() / fProgress / v2Resolution of Renderer::transitionShaderTemplate;
+  // the HLSL templates #define the GLSL names, so one body serves every renderer
+  struct TRANSITION
+  {
+    const char * szName;
+    const char * szBody;
+  };
+  TRANSITION transitions[] = {
+    { "fade",
+      "vec4 transition( vec2 uv )\n"
+      "{\n"
+      "  return mix( from( uv ), to( uv ), fProgress );\n"
+      "}\n" },
+    { "wipe",
+      "vec4 transition( vec2 uv )\n"
+      "{\n"
+      "  float edge = smoothstep( fProgress * 1.2 - 0.2, fProgress * 1.2, uv.x );\n"
+      "  return mix( to( uv ), from( uv ), edge );\n"
+      "}\n" },
+    { "dissolve",
+      "vec4 transition( vec2 uv )\n"
+      "{\n"
+      "  vec2 cell = floor( uv * v2Resolution / 4.0 );\n"
+      "  float noise = fract( sin( dot( cell, vec2( 12.9898, 78.233 ) ) ) * 43758.5453 );\n"
+      "  return mix( from( uv ), to( uv ), smoothstep( noise - 0.1, noise + 0.1, fProgress * 1.2 - 0.1 ) );\n"
+      "}\n" },
+  };
+
+  Renderer::Shader * pTransitionShader = NULL;
+  Renderer::Texture * pOutgoingTarget = NULL;
+  Renderer::Texture * pIncomingTarget = NULL;
+  double fTransitionDuration = 0.0;
+
+  Renderer::Shader * pOutgoingShader = NULL;
+  bool bOutgoingOwned = false;
+  double fStartTime = 0.0;
+  bool bRunning = false;
+
+  const char * FindTransition( const char * szName )
+  {
+    for (int i = 0; i < sizeof(transitions) / sizeof(transitions[0]); i++)
+    {
+      if (strcmp( szName, transitions[i].szName ) == 0)
+        return transitions[i].szBody;
+    }
+    return NULL;
+  }
+
+  bool IsValidTransition( const char * szName )
+  {
+    return strcmp( szName, "cut" ) == 0 || FindTransition( szName ) != NULL;
+  }
+
+  bool Open( int nWidth, int nHeight, const char * szTransition, double fDuration, float fOutgoingScale )
+  {
+    const char * szBody = FindTransition( szTransition );
+    if (!szBody || fDuration <= 0.0)
+      return true; // hard cuts, nothing to set up
+
+    std::string sShader = Renderer::transitionShaderTemplate;
+    const char * szToken = "{%transition%}";
+    sShader.replace( sShader.find( szToken ), strlen( szToken ), szBody );
+
+    std::string sError;
+    pTransitionShader = Renderer::CompileShader( sShader.c_str(), sShader.length(), sError );
+    if (!pTransitionShader)
+    {
+      printf("[Compositor] Transition \"%s\" failed to compile:\n%s\n", szTransition, sError.c_str());
+      return false;
+    }
+
+    fOutgoingScale = fOutgoingScale < 0.1f ? 0.1f : fOutgoingScale > 1.0f ? 1.0f : fOutgoingScale;
+    int nOutgoingWidth = (int)(nWidth * fOutgoingScale);
+    int nOutgoingHeight = (int)(nHeight * fOutgoingScale);
+    pOutgoingTarget = Renderer::CreateRenderTarget( nOutgoingWidth < 1 ? 1 : nOutgoingWidth, nOutgoingHeight < 1 ? 1 : nOutgoingHeight );
+    pIncomingTarget = Renderer::CreateRenderTarget( nWidth, nHeight );
+    if (!pOutgoingTarget || !pIncomingTarget)
+    {
+      Close();
+      return false;
+    }
+
+    fTransitionDuration = fDuration;
+    printf("[Compositor] %.2fs %s transitions, outgoing shader at %d x %d\n", fDuration, szTransition, pOutgoingTarget->width, pOutgoingTarget->height);
+    return true;
+  }
+
+  void End()
+  {
+    if (bOutgoingOwned)
+      Renderer::ReleaseShader( pOutgoingShader );
+    pOutgoingShader = NULL;
+    bOutgoingOwned = false;
+    bRunning = false;
+  }
+
+  void Start( Renderer::Shader * pFrom, bool bOwned, double fTime )
+  {
+    // only one transition at a time: whatever was fading out is gone as of now
+    if (bRunning)
+      End();
+
+    if (!pTransitionShader || !pFrom)
+    {
+      if (bOwned)
+        Renderer::ReleaseShader( pFrom );
+      return;
+    }
+
+    pOutgoingShader = pFrom;
+    bOutgoingOwned = bOwned;
+    fStartTime = fTime;
+    bRunning = true;
+  }
+
+  bool IsRunning()
+  {
+    return bRunning;
+  }
+
+  Renderer::Shader * GetOutgoingShader()
+  {
+    return pOutgoingShader;
+  }
+
+  Renderer::Texture * BeginOutgoing()
+  {
+    Renderer::SetRenderTarget( pOutgoingTarget );
+    return pOutgoingTarget;
+  }
+
+  Renderer::Texture * BeginIncoming()
+  {
+    Renderer::SetRenderTarget( pIncomingTarget );
+    return pIncomingTarget;
+  }
+
+  void Composite( double fTime )
+  {
+    float fProgress = (float)((fTime - fStartTime) / fTransitionDuration);
+    fProgress = fProgress < 0.0f ? 0.0f : fProgress > 1.0f ? 1.0f : fProgress;
+
+    Renderer::SetRenderTarget( NULL );
+    Renderer::SetShader( pTransitionShader );
+    Renderer::SetShaderTexture( "texFrom", pOutgoingTarget );
+    Renderer::SetShaderTexture( "texTo", pIncomingTarget );
+    Renderer::SetShaderConstant( "fProgress", fProgress );
+    Renderer::SetShaderConstant( "v2Resolution", (float)pIncomingTarget->width, (float)pIncomingTarget->height );
+    Renderer::RenderFullscreenQuad();
+
+    if (fProgress >= 1.0f)
+      End();
+  }
+
+  void Close()
+  {
+    if (bRunning)
+      End();
+    Renderer::ReleaseShader( pTransitionShader );
+    pTransitionShader = NULL;
+    if (pOutgoingTarget)
+      Renderer::ReleaseTexture( pOutgoingTarget );
+    if (pIncomingTarget)
+      Renderer::ReleaseTexture( pIncomingTarget );
+    pOutgoingTarget = pIncomingTarget = NULL;
+  }
+}
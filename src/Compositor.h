@@ -0,0 +1,22 @@
+namespace Compositor
+{
+  // Crossfades between two shaders when the picture changes (recompile, tab
+  // switch): both render into offscreen targets and a transition shader mixes
+  // them onto the back buffer. The outgoing shader only runs at fOutgoingScale
+  // of the resolution during the fade, since it's on its way out anyway.
+  // fDuration <= 0 or szTransition "cut" disables it and Start() becomes a hard cut.
+  bool Open( int nWidth, int nHeight, const char * szTransition, double fDuration, float fOutgoingScale );
+  void Close();
+
+  // bOwned: pFrom isn't referenced anywhere else, so it gets released once the transition is over
+  void Start( Renderer::Shader * pFrom, bool bOwned, double fTime );
+  bool IsRunning();
+  Renderer::Shader * GetOutgoingShader(); // NULL when no transition is running
+
+  // bind the target for the shader about to render, and return it so the caller knows the resolution
+  Renderer::Texture * BeginOutgoing();
+  Renderer::Texture * BeginIncoming();
+  void Composite( double fTime ); // mixes both onto the back buffer, and ends the transition when it's done
+
+  bool IsValidTransition( const char * szName );
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+#include "Misc.h"
+#include "FileWatcher.h"
+
+namespace FileWatcher
+{
+  struct WatchedFile
+  {
+    std::string sPath; // as given to Watch()
+    unsigned long long nSize; // the polling fallback compares these
+    unsigned long long nModified;
+  };
+
+  std::mutex mutex; // guards everything below up to the thread state
+  std::map<std::string, WatchedFile> files; // keyed by "directory/name"
+  std::set<std::string> watchedDirectories;
+  std::map<std::string, std::chrono::steady_clock::time_point> pending; // path -> last time it changed
+  std::vector<std::string> ready;
+
+  std::thread watchThread;
+  std::atomic<bool> bRunning( false );
+  std::chrono::milliseconds debounce( 100 );
+
+  void SplitPath( const std::string & sPath, std::string & sDirectory, std::string & sName )
+  {
+    size_t nSlash = sPath.find_last_of( "/\\" );
+    sDirectory = nSlash == std::string::npos ? "." : nSlash == 0 ? "/" : sPath.substr( 0, nSlash );
+    sName = nSlash == std::string::npos ? sPath : sPath.substr( nSlash + 1 );
+  }
+
+  // with the mutex held
+  void MarkChanged( const std::string & sKey )
+  {
+    std::map<std::string, WatchedFile>::iterator it = files.find( sKey );
+    if (it != files.end())
+      pending[ it->second.sPath ] = std::chrono::steady_clock::now();
+  }
+
+  void SettlePending()
+  {
+    std::lock_guard<std::mutex> lock( mutex );
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (std::map<std::string, std::chrono::steady_clock::time_point>::iterator it = pending.begin(); it != pending.end(); )
+    {
+      if (now - it->second < debounce)
+      {
+        it++;
+        continue;
+      }
+      ready.push_back( it->first );
+      pending.erase( it++ );
+    }
+  }
+
+#ifdef __linux__
+  int nInotify = -1;
+  std::map<int, std::string> directories; // watch descriptor -> directory
+
+  bool OpenBackend()
+  {
+    nInotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if (nInotify < 0)
+    {
+      printf("[FileWatcher] inotify_init1 failed\n");
+      return false;
+    }
+    return true;
+  }
+
+  void CloseBackend()
+  {
+    close( nInotify ); // drops all the watches too
+    nInotify = -1;
+    directories.clear();
+  }
+
+  // with the mutex held
+  void AddBackendWatch( const std::string & sDirectory )
+  {
+    int nWatch = inotify_add_watch( nInotify, sDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY );
+    if (nWatch < 0)
+      printf("[FileWatcher] Cannot watch %s\n", sDirectory.c_str());
+    else
+      directories[ nWatch ] = sDirectory;
+  }
+
+  void WaitForChanges()
+  {
+    struct pollfd fd;
+    fd.fd = nInotify;
+    fd.events = POLLIN;
+    if (poll( &fd, 1, 50 ) <= 0) // short, it's also the debounce resolution
+      return;
+
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while (true)
+    {
+      ssize_t nLength = read( nInotify, buffer, sizeof(buffer) );
+      if (nLength <= 0)
+        break;
+
+      std::lock_guard<std::mutex> lock( mutex );
+      for (char * p = buffer; p < buffer + nLength; )
+      {
+        const struct inotify_event * event = (const struct inotify_event *)p;
+        std::map<int, std::string>::iterator it = directories.find( event->wd );
+        if (event->len && it != directories.end())
+          MarkChanged( it->second + "/" + event->name );
+        p += sizeof(struct inotify_event) + event->len;
+      }
+    }
+  }
+#else
+  // no change notifications here, so the stamps of the watched files are polled
+  bool OpenBackend()
+  {
+    return true;
+  }
+
+  void CloseBackend()
+  {
+  }
+
+  void AddBackendWatch( const std::string & sDirectory )
+  {
+  }
+
+  void WaitForChanges()
+  {
+    std::this_thread::sleep_for( std::chrono::milliseconds( 250 ) );
+
+    std::lock_guard<std::mutex> lock( mutex );
+    for (std::map<std::string, WatchedFile>::iterator it = files.begin(); it != files.end(); it++)
+    {
+      unsigned long long nSize = 0;
+      unsigned long long nModified = 0;
+      if (!Misc::GetFileStamp( it->second.sPath.c_str(), nSize, nModified ))
+        continue; // in the middle of being replaced, probably
+      if (nSize == it->second.nSize && nModified == it->second.nModified)
+        continue;
+      it->second.nSize = nSize;
+      it->second.nModified = nModified;
+      MarkChanged( it->first );
+    }
+  }
+#endif
+
+  void WatchThread()
+  {
+    while (bRunning)
+    {
+      WaitForChanges();
+      SettlePending();
+    }
+  }
+
+  bool Open( int nDebounceMS )
+  {
+    if (!OpenBackend())
+      return false;
+
+    debounce = std::chrono::milliseconds( nDebounceMS );
+    bRunning = true;
+    watchThread = std::thread( WatchThread );
+    return true;
+  }
+
+  void Close()
+  {
+    if (!bRunning)
+      return;
+
+    bRunning = false;
+    watchThread.join();
+    CloseBackend();
+    files.clear();
+    watchedDirectories.clear();
+    pending.clear();
+    ready.clear();
+  }
+
+  void Watch( const char * szPath )
+  {
+    if (!bRunning)
+      return;
+
+    std::string sDirectory;
+    std::string sName;
+    SplitPath( szPath, sDirectory, sName );
+    std::string sKey = sDirectory + "/" + sName;
+
+    std::lock_guard<std::mutex> lock( mutex );
+    if (files.count( sKey ))
+      return;
+
+    if (watchedDirectories.insert( sDirectory ).second)
+      AddBackendWatch( sDirectory );
+
+    WatchedFile & file = files[ sKey ];
+    file.sPath = szPath;
+    file.nSize = 0;
+    file.nModified = 0;
+    Misc::GetFileStamp( szPath, file.nSize, file.nModified );
+  }
+
+  bool PopChange( std::string & sPath )
+  {
+    std::lock_guard<std::mutex> lock( mutex );
+    if (ready.empty())
+      return false;
+    sPath = ready.front();
+    ready.erase( ready.begin() );
+    return true;
+  }
+}
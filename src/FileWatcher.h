@@ -0,0 +1,15 @@
+#include <string>
+
+namespace FileWatcher
+{
+  // Watches files on a background thread (inotify on Linux, polling the file
+  // stamps elsewhere) and reports a file once it has been quiet for the
+  // debounce time, so an editor saving in several steps or a script rewriting
+  // a texture only causes one reload. The directories are watched rather than
+  // the files, so editors that save by renaming a temporary file are caught too.
+  bool Open( int nDebounceMS );
+  void Close();
+
+  void Watch( const char * szPath ); // from any thread; watching the same path again is harmless
+  bool PopChange( std::string & sPath ); // the next settled file, as it was passed to Watch(); false if none
+}
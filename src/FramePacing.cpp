@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+#include "Renderer.h"
+#include "Timer.h"
+#include "FramePacing.h"
+
+namespace FramePacing
+{
+  // below this much remaining time we stop trusting the OS scheduler and spin
+#ifdef _WIN32
+  const unsigned long long nSpinThreshold = 2000000;
+#else
+  const unsigned long long nSpinThreshold = 1000000;
+#endif
+
+  RENDERER_FRAMEPACING mode = RENDERER_FRAMEPACING_VSYNC;
+  unsigned long long nFramePeriod = 0;
+  unsigned long long nNextDeadline = 0;
+  unsigned long long nLastFrame = 0;
+  bool bStarted = false;
+
+  unsigned long long nReportInterval = 0;
+  unsigned long long nLastReport = 0;
+
+  struct FrameStats
+  {
+    unsigned int nFrames;
+    unsigned int nLateFrames;
+    double fSum;
+    double fSumSquared;
+    double fMin;
+    double fMax;
+  };
+  FrameStats intervalStats;
+  FrameStats totalStats;
+
+  void ResetStats( FrameStats & stats )
+  {
+    memset( &stats, 0, sizeof(FrameStats) );
+    stats.fMin = 1e9;
+  }
+
+  void AddToStats( FrameStats & stats, double fFrameTime )
+  {
+    // a frame taking over 1.5x the average so far has skipped at least one refresh / slot
+    if (stats.nFrames && fFrameTime > 1.5 * stats.fSum / stats.nFrames)
+      stats.nLateFrames++;
+    stats.nFrames++;
+    stats.fSum += fFrameTime;
+    stats.fSumSquared += fFrameTime * fFrameTime;
+    if (fFrameTime < stats.fMin) stats.fMin = fFrameTime;
+    if (fFrameTime > stats.fMax) stats.fMax = fFrameTime;
+  }
+
+  void PrintStats( const char * szLabel, FrameStats & stats )
+  {
+    if (!stats.nFrames)
+      return;
+
+    double fMean = stats.fSum / stats.nFrames;
+    double fVariance = stats.fSumSquared / stats.nFrames - fMean * fMean;
+    double fJitter = fVariance > 0.0 ? sqrt( fVariance ) : 0.0;
+    printf("[FramePacing] %s: %.2f fps, frame time %.2f ms (min %.2f, max %.2f), jitter %.3f ms, %u late frames\n",
+      szLabel, 1000.0 / fMean, fMean, stats.fMin, stats.fMax, fJitter, stats.nLateFrames);
+  }
+
+  void WaitUntil( unsigned long long nDeadline )
+  {
+    while (true)
+    {
+      unsigned long long nNow = Timer::GetTimeNS();
+      if (nNow >= nDeadline)
+        break;
+
+      unsigned long long nRemaining = nDeadline - nNow;
+      if (nRemaining > nSpinThreshold)
+        std::this_thread::sleep_for( std::chrono::nanoseconds( nRemaining - nSpinThreshold ) );
+      else
+        std::this_thread::yield();
+    }
+  }
+
+  void Open( RENDERER_SETTINGS & settings, float fReportInterval )
+  {
+    mode = settings.framePacing;
+    nFramePeriod = 0;
+    if (mode == RENDERER_FRAMEPACING_FIXED)
+    {
+      if (settings.fTargetFrameRate <= 0.0f)
+      {
+        printf("[FramePacing] Invalid target frame rate %.2f, running uncapped\n", settings.fTargetFrameRate);
+        mode = RENDERER_FRAMEPACING_UNCAPPED;
+      }
+      else
+      {
+        nFramePeriod = (unsigned long long)(1000000000.0 / settings.fTargetFrameRate);
+#ifdef _WIN32
+        timeBeginPeriod( 1 ); // default scheduler granularity is ~15.6ms, way too coarse to sleep in
+#endif
+      }
+    }
+
+    nReportInterval = (unsigned long long)(fReportInterval * 1000000000.0);
+    bStarted = false;
+    ResetStats( intervalStats );
+    ResetStats( totalStats );
+
+    if (mode == RENDERER_FRAMEPACING_FIXED)
+      printf("[FramePacing] Mode: %s, %.2f fps\n", GetModeName( mode ), settings.fTargetFrameRate);
+    else
+      printf("[FramePacing] Mode: %s\n", GetModeName( mode ));
+  }
+
+  void Tick()
+  {
+    unsigned long long nNow = Timer::GetTimeNS();
+    if (!bStarted)
+    {
+      // the timer might have been restarted since Open(), so the first frame only sets the baseline
+      nLastFrame = nNextDeadline = nLastReport = nNow;
+      bStarted = true;
+      return;
+    }
+
+    if (nFramePeriod)
+    {
+      nNextDeadline += nFramePeriod;
+      if (nNow > nNextDeadline + nFramePeriod)
+      {
+        // more than a frame behind (slow shader, window drag, ...): don't try to catch up
+        nNextDeadline = nNow;
+      }
+      else if (nNow < nNextDeadline)
+      {
+        WaitUntil( nNextDeadline );
+        nNow = Timer::GetTimeNS();
+      }
+    }
+
+    double fFrameTime = (nNow - nLastFrame) / 1000000.0;
+    nLastFrame = nNow;
+
+    AddToStats( intervalStats, fFrameTime );
+    AddToStats( totalStats, fFrameTime );
+
+    if (nReportInterval && nNow - nLastReport >= nReportInterval)
+    {
+      PrintStats( "last interval", intervalStats );
+      ResetStats( intervalStats );
+      nLastReport = nNow;
+    }
+  }
+
+  void Close()
+  {
+    if (nReportInterval)
+      PrintStats( "session", totalStats );
+#ifdef _WIN32
+    if (nFramePeriod)
+      timeEndPeriod( 1 );
+#endif
+    nFramePeriod = 0;
+  }
+
+  const char * szModeNames[] = { "uncapped", "vsync", "fixed", "adaptive" };
+
+  const char * GetModeName( RENDERER_FRAMEPACING mode )
+  {
+    return szModeNames[ mode ];
+  }
+
+  bool GetModeFromName( const char * szName, RENDERER_FRAMEPACING & mode )
+  {
+    for (int i = 0; i < sizeof(szModeNames) / sizeof(szModeNames[0]); i++)
+    {
+      if (strcmp( szName, szModeNames[i] ) == 0)
+      {
+        mode = (RENDERER_FRAMEPACING)i;
+        return true;
+      }
+    }
+    return false;
+  }
+}
@@ -0,0 +1,10 @@
+namespace FramePacing
+{
+  // fReportInterval: seconds between frame time reports on stdout, 0 to disable
+  void Open( RENDERER_SETTINGS & settings, float fReportInterval );
+  void Tick(); // once per frame, right after Renderer::EndFrame(); sleeps in RENDERER_FRAMEPACING_FIXED
+  void Close();
+
+  const char * GetModeName( RENDERER_FRAMEPACING mode );
+  bool GetModeFromName( const char * szName, RENDERER_FRAMEPACING & mode );
+}
@@ -1,6 +1,8 @@
+#include <atomic>
+
 namespace MIDI
 {
-  enum
+  typedef enum
   {
     MIDIMSG_NOTE_OFF         = 8,
     MIDIMSG_NOTE_ON          = 9,
@@ -12,7 +14,88 @@ namespace MIDI
     MIDIMSG_SYSTEM           = 15,
   } MIDI_MESSAGE_TYPE;
 
+  struct Event
+  {
+    unsigned long long nTime; // Timer::GetTimeNS() when it arrived
+    unsigned char nType; // MIDI_MESSAGE_TYPE
+    unsigned char nChannel; // 0..15
+    unsigned char nData1; // note / controller; the low 7 bits for pitch bend
+    unsigned char nData2; // velocity / value; the high 7 bits for pitch bend
+  };
+
+  // Single producer (the driver / input thread), single consumer (Update() on
+  // the render thread); when it's full, new events are dropped and counted.
+#define MIDI_QUEUE_SIZE 1024
+  class EventQueue
+  {
+    Event events[MIDI_QUEUE_SIZE];
+    std::atomic<unsigned int> nWrite;
+    std::atomic<unsigned int> nRead;
+
+  public:
+    std::atomic<unsigned int> nDropped;
+
+    EventQueue() : nWrite(0), nRead(0), nDropped(0) {}
+
+    bool Push( const Event & e )
+    {
+      unsigned int w = nWrite.load( std::memory_order_relaxed );
+      if (w - nRead.load( std::memory_order_acquire ) >= MIDI_QUEUE_SIZE)
+      {
+        nDropped++;
+        return false;
+      }
+      events[ w % MIDI_QUEUE_SIZE ] = e;
+      nWrite.store( w + 1, std::memory_order_release );
+      return true;
+    }
+
+    bool Pop( Event & e )
+    {
+      unsigned int r = nRead.load( std::memory_order_relaxed );
+      if (r == nWrite.load( std::memory_order_acquire ))
+        return false;
+      e = events[ r % MIDI_QUEUE_SIZE ];
+      nRead.store( r + 1, std::memory_order_release );
+      return true;
+    }
+  };
+
+  // what a shader variable is bound to, see ParseRoute()
+  struct Route
+  {
+    MIDI_MESSAGE_TYPE type; // MIDIMSG_CONTROL_CHANGE, MIDIMSG_NOTE_ON or MIDIMSG_PITCH_BEND
+    int nChannel; // 0..15, or -1 for whichever channel changed last
+    int nNumber; // controller or note
+    bool b14Bit; // CC 0..31 paired with CC 32..63 as the low 7 bits
+  };
+
+  // implemented per platform
   bool Open();
   bool Close();
-  float GetCCValue( unsigned char cc );
-};
\ No newline at end of file
+
+  // MIDIState.cpp
+  void AddQueue( EventQueue * queue ); // before the backend starts pushing
+  void RemoveQueues();
+  void Update(); // once per frame on the render thread: drains the queues into the channel state
+
+  // 16 -> CC 16; "cc:16", "cc:2:16" -> CC 16 (on channel 2); "cc14:1", "cc14:2:1" -> CC 1 and 33 as
+  // one 14 bit value; "note:60", "note:2:60" -> velocity of note 60 while held, 0 after release;
+  // "pitchbend", "pitchbend:2" -> -1..1
+  bool ParseRoute( const char * szSource, Route & route );
+  float GetValue( const Route & route );
+  float GetCCValue( unsigned char cc ); // same as the "cc:<cc>" route
+
+  // Everything at once, for shaders that want more than a handful of named
+  // routes; both fill RGBA32F texel arrays, one row per channel / one row total.
+  // State: x 0..127 is CC, 128..255 note velocity, 256 pitch bend (-1..1);
+  // r is the value, g the seconds since it last changed.
+  // History: the last MIDI_HISTORY_SIZE events, newest at x = 0; r is the
+  // seconds since it arrived, g the MIDI_MESSAGE_TYPE, b channel * 128 + CC / note,
+  // a the value.
+#define MIDI_STATE_TEXTURE_WIDTH 257
+#define MIDI_STATE_TEXTURE_HEIGHT 16
+#define MIDI_HISTORY_SIZE 256
+  void GetStateTexture( float * data, unsigned long long nNow ); // MIDI_STATE_TEXTURE_WIDTH * MIDI_STATE_TEXTURE_HEIGHT * 4 floats
+  void GetHistoryTexture( float * data, unsigned long long nNow ); // MIDI_HISTORY_SIZE * 4 floats
+};
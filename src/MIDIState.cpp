@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "MIDI.h"
+
+namespace MIDI
+{
+  struct ChannelState
+  {
+    unsigned char nCC[128];
+    unsigned char nNoteVelocity[128]; // 0 while the note is off
+    int nPitchBend; // -8192..8191
+    unsigned long long nCCTime[128];
+    unsigned long long nNoteTime[128];
+    unsigned long long nPitchBendTime;
+  };
+  ChannelState channels[16];
+
+  // for the routes that don't care about the channel
+  int nLastCCChannel[128];
+  int nLastPitchBendChannel = 0;
+
+  // what GetHistoryTexture() sees, newest at nHistoryCount - 1
+  Event history[MIDI_HISTORY_SIZE];
+  unsigned int nHistoryCount = 0;
+
+  std::vector<EventQueue *> queues;
+  unsigned int nReportedDrops = 0;
+
+  void AddQueue( EventQueue * queue )
+  {
+    queues.push_back( queue );
+  }
+
+  void RemoveQueues()
+  {
+    queues.clear();
+  }
+
+  void ApplyEvent( const Event & e )
+  {
+    ChannelState & channel = channels[ e.nChannel & 0x0F ];
+    switch (e.nType)
+    {
+      case MIDIMSG_NOTE_ON:
+        channel.nNoteVelocity[ e.nData1 & 0x7F ] = e.nData2; // a velocity of 0 is a note off
+        channel.nNoteTime[ e.nData1 & 0x7F ] = e.nTime;
+        break;
+      case MIDIMSG_NOTE_OFF:
+        channel.nNoteVelocity[ e.nData1 & 0x7F ] = 0;
+        channel.nNoteTime[ e.nData1 & 0x7F ] = e.nTime;
+        break;
+      case MIDIMSG_CONTROL_CHANGE:
+        channel.nCC[ e.nData1 & 0x7F ] = e.nData2;
+        channel.nCCTime[ e.nData1 & 0x7F ] = e.nTime;
+        nLastCCChannel[ e.nData1 & 0x7F ] = e.nChannel & 0x0F;
+        break;
+      case MIDIMSG_PITCH_BEND:
+        channel.nPitchBend = (((e.nData2 & 0x7F) << 7) | (e.nData1 & 0x7F)) - 8192;
+        channel.nPitchBendTime = e.nTime;
+        nLastPitchBendChannel = e.nChannel & 0x0F;
+        break;
+      default:
+        return;
+    }
+    history[ nHistoryCount++ % MIDI_HISTORY_SIZE ] = e;
+  }
+
+  void Update()
+  {
+    unsigned int nDropped = 0;
+    for (int i = 0; i < queues.size(); i++)
+    {
+      Event e;
+      while (queues[i]->Pop( e ))
+        ApplyEvent( e );
+      nDropped += queues[i]->nDropped;
+    }
+    if (nDropped != nReportedDrops)
+    {
+      printf("[MIDI] Event queue overflow, %u events dropped so far\n", nDropped);
+      nReportedDrops = nDropped;
+    }
+  }
+
+  bool ParseRoute( const char * szSource, Route & route )
+  {
+    int a = 0;
+    int b = 0;
+    route.nChannel = -1;
+    route.nNumber = 0;
+    route.b14Bit = false;
+    if (sscanf( szSource, "cc14:%d:%d", &a, &b ) == 2)
+    {
+      route.type = MIDIMSG_CONTROL_CHANGE;
+      route.nChannel = a - 1;
+      route.nNumber = b;
+      route.b14Bit = true;
+    }
+    else if (sscanf( szSource, "cc14:%d", &a ) == 1)
+    {
+      route.type = MIDIMSG_CONTROL_CHANGE;
+      route.nNumber = a;
+      route.b14Bit = true;
+    }
+    else if (sscanf( szSource, "cc:%d:%d", &a, &b ) == 2)
+    {
+      route.type = MIDIMSG_CONTROL_CHANGE;
+      route.nChannel = a - 1;
+      route.nNumber = b;
+    }
+    else if (sscanf( szSource, "cc:%d", &a ) == 1 || sscanf( szSource, "%d", &a ) == 1)
+    {
+      route.type = MIDIMSG_CONTROL_CHANGE;
+      route.nNumber = a;
+    }
+    else if (sscanf( szSource, "note:%d:%d", &a, &b ) == 2)
+    {
+      route.type = MIDIMSG_NOTE_ON;
+      route.nChannel = a - 1;
+      route.nNumber = b;
+    }
+    else if (sscanf( szSource, "note:%d", &a ) == 1)
+    {
+      route.type = MIDIMSG_NOTE_ON;
+      route.nNumber = a;
+    }
+    else if (sscanf( szSource, "pitchbend:%d", &a ) == 1)
+    {
+      route.type = MIDIMSG_PITCH_BEND;
+      route.nChannel = a - 1;
+    }
+    else if (strcmp( szSource, "pitchbend" ) == 0)
+    {
+      route.type = MIDIMSG_PITCH_BEND;
+    }
+    else
+    {
+      return false;
+    }
+    return route.nChannel >= -1 && route.nChannel < 16 && route.nNumber >= 0 && route.nNumber < (route.b14Bit ? 32 : 128);
+  }
+
+  float GetValue( const Route & route )
+  {
+    switch (route.type)
+    {
+      case MIDIMSG_CONTROL_CHANGE:
+        {
+          const ChannelState & channel = channels[ route.nChannel < 0 ? nLastCCChannel[ route.nNumber ] : route.nChannel ];
+          if (route.b14Bit)
+            return ((channel.nCC[ route.nNumber ] << 7) | channel.nCC[ route.nNumber + 32 ]) / 16383.0f;
+          return channel.nCC[ route.nNumber ] / 127.0f;
+        }
+      case MIDIMSG_NOTE_ON:
+        if (route.nChannel < 0)
+        {
+          unsigned char nVelocity = 0;
+          for (int i = 0; i < 16; i++)
+            nVelocity = channels[i].nNoteVelocity[ route.nNumber ] > nVelocity ? channels[i].nNoteVelocity[ route.nNumber ] : nVelocity;
+          return nVelocity / 127.0f;
+        }
+        return channels[ route.nChannel ].nNoteVelocity[ route.nNumber ] / 127.0f;
+      case MIDIMSG_PITCH_BEND:
+        return channels[ route.nChannel < 0 ? nLastPitchBendChannel : route.nChannel ].nPitchBend / 8192.0f;
+      default: // ParseRoute only makes the ones above
+        break;
+    }
+    return 0.0f;
+  }
+
+  float GetCCValue( unsigned char cc )
+  {
+    cc &= 0x7F;
+    return channels[ nLastCCChannel[cc] ].nCC[cc] / 127.0f;
+  }
+
+  // never-touched values read as long ago, rather than as a change at startup
+  float SecondsSince( unsigned long long nTime, unsigned long long nNow )
+  {
+    if (!nTime)
+      return 1000000.0f;
+    return nNow > nTime ? (float)((nNow - nTime) / 1000000000.0) : 0.0f;
+  }
+
+  void GetStateTexture( float * data, unsigned long long nNow )
+  {
+    for (int y = 0; y < MIDI_STATE_TEXTURE_HEIGHT; y++)
+    {
+      const ChannelState & channel = channels[y];
+      float * row = data + y * MIDI_STATE_TEXTURE_WIDTH * 4;
+      for (int i = 0; i < 128; i++)
+      {
+        float * cc = row + i * 4;
+        cc[0] = channel.nCC[i] / 127.0f;
+        cc[1] = SecondsSince( channel.nCCTime[i], nNow );
+        cc[2] = 0.0f;
+        cc[3] = 0.0f;
+
+        float * note = row + (128 + i) * 4;
+        note[0] = channel.nNoteVelocity[i] / 127.0f;
+        note[1] = SecondsSince( channel.nNoteTime[i], nNow );
+        note[2] = 0.0f;
+        note[3] = 0.0f;
+      }
+      float * bend = row + 256 * 4;
+      bend[0] = channel.nPitchBend / 8192.0f;
+      bend[1] = SecondsSince( channel.nPitchBendTime, nNow );
+      bend[2] = 0.0f;
+      bend[3] = 0.0f;
+    }
+  }
+
+  void GetHistoryTexture( float * data, unsigned long long nNow )
+  {
+    for (unsigned int i = 0; i < MIDI_HISTORY_SIZE; i++)
+    {
+      float * texel = data + i * 4;
+      if (i >= nHistoryCount)
+      {
+        texel[0] = 1000000.0f;
+        texel[1] = 0.0f;
+        texel[2] = 0.0f;
+        texel[3] = 0.0f;
+        continue;
+      }
+      const Event & e = history[ (nHistoryCount - 1 - i) % MIDI_HISTORY_SIZE ];
+      texel[0] = SecondsSince( e.nTime, nNow );
+      texel[1] = e.nType;
+      texel[2] = (float)((e.nChannel & 0x0F) * 128 + (e.nData1 & 0x7F));
+      switch (e.nType)
+      {
+        case MIDIMSG_PITCH_BEND:
+          texel[2] = (float)((e.nChannel & 0x0F) * 128);
+          texel[3] = ((((e.nData2 & 0x7F) << 7) | (e.nData1 & 0x7F)) - 8192) / 8192.0f;
+          break;
+        case MIDIMSG_NOTE_OFF:
+          texel[3] = 0.0f;
+          break;
+        default:
+          texel[3] = e.nData2 / 127.0f;
+          break;
+      }
+    }
+  }
+}
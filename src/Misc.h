@@ -10,5 +10,9 @@ namespace Misc
   bool ExecuteCommand( const char * cmd, const char * param );
 
   bool FileExists(const char * path);
+  const void * MapFile(const char * path, size_t & size); // read-only, whole file; NULL on failure
+  void UnmapFile(const void * data, size_t size);
+  bool GetFileStamp(const char * path, unsigned long long & size, unsigned long long & modified); // modified is in platform units, only good for comparing
+  bool MakeDirectory(const char * path); // also true if it already exists
   const char * GetDefaultFontPath();
 }
\ No newline at end of file
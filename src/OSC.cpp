@@ -0,0 +1,373 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include "jsonxx.h"
+#include "OSC.h"
+
+#ifndef _WIN32
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#define OSC_MAX_ADDRESSES 256
+#define OSC_HASH_SIZE 512 // power of two, at least twice OSC_MAX_ADDRESSES so probing stays short
+#define OSC_MAX_MESSAGES 1024 // per packet; UDP caps a packet at 64k and a message takes at least 8 bytes
+#define OSC_MAX_BUNDLE_DEPTH 8
+#define OSC_PACKET_SIZE 65536
+
+namespace OSC
+{
+  // views into the packet buffer, valid until the next packet arrives
+  struct MESSAGE
+  {
+    const char * szAddress;
+    const char * szTypes; // without the leading ','
+    const unsigned char * pArgs;
+    const unsigned char * pEnd;
+  };
+
+  struct Slot
+  {
+    std::string sAddress;
+    std::atomic<float> fValue;
+  };
+
+  bool bEnabled = false;
+  int nPort = 9000;
+
+  // filled in before the listener starts and read-only afterwards, so the
+  // listener can look addresses up without any locking
+  Slot slots[OSC_MAX_ADDRESSES];
+  int nSlotCount = 0;
+  short nHashTable[OSC_HASH_SIZE]; // slot index + 1, 0 for empty
+
+  SOCKET sock = INVALID_SOCKET;
+  std::thread listenerThread;
+  std::atomic<bool> bRunning( false );
+
+  // only touched by the listener thread
+  unsigned char packet[OSC_PACKET_SIZE];
+  MESSAGE messages[OSC_MAX_MESSAGES];
+  int nMessageCount = 0;
+  unsigned int nPacketCount = 0;
+  unsigned int nMalformedCount = 0;
+  unsigned int nOverflowCount = 0;
+
+  void LoadSettings( jsonxx::Object & o )
+  {
+    if (!o.has<jsonxx::Object>("osc"))
+      return;
+
+    jsonxx::Object & osc = o.get<jsonxx::Object>("osc");
+    bEnabled = true;
+    if (osc.has<jsonxx::Boolean>("enabled"))
+      bEnabled = osc.get<jsonxx::Boolean>("enabled");
+    if (osc.has<jsonxx::Number>("port"))
+      nPort = (int)osc.get<jsonxx::Number>("port");
+  }
+
+  unsigned int HashAddress( const char * szAddress )
+  {
+    unsigned int nHash = 2166136261u;
+    while (*szAddress)
+    {
+      nHash ^= (unsigned char)*szAddress++;
+      nHash *= 16777619u;
+    }
+    return nHash;
+  }
+
+  int FindSlot( const char * szAddress )
+  {
+    for (unsigned int i = HashAddress( szAddress ) & (OSC_HASH_SIZE - 1); nHashTable[i]; i = (i + 1) & (OSC_HASH_SIZE - 1))
+    {
+      if (strcmp( slots[ nHashTable[i] - 1 ].sAddress.c_str(), szAddress ) == 0)
+        return nHashTable[i] - 1;
+    }
+    return -1;
+  }
+
+  // several variables can listen to the same address, they share the slot
+  int AddAddress( const char * szAddress )
+  {
+    int nSlot = FindSlot( szAddress );
+    if (nSlot >= 0)
+      return nSlot;
+    if (bRunning || nSlotCount >= OSC_MAX_ADDRESSES)
+      return -1;
+
+    nSlot = nSlotCount++;
+    slots[nSlot].sAddress = szAddress;
+    slots[nSlot].fValue = 0.0f;
+
+    unsigned int i = HashAddress( szAddress ) & (OSC_HASH_SIZE - 1);
+    while (nHashTable[i])
+      i = (i + 1) & (OSC_HASH_SIZE - 1);
+    nHashTable[i] = nSlot + 1;
+    return nSlot;
+  }
+
+  unsigned int ReadInt32( const unsigned char * p )
+  {
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+  }
+
+  unsigned long long ReadInt64( const unsigned char * p )
+  {
+    return ((unsigned long long)ReadInt32( p ) << 32) | ReadInt32( p + 4 );
+  }
+
+  // OSC strings are NUL terminated and padded to 4 bytes; returns the byte
+  // after the padding, or NULL if the terminator isn't in [p, pEnd)
+  const unsigned char * SkipString( const unsigned char * p, const unsigned char * pEnd )
+  {
+    const unsigned char * pNul = (const unsigned char *)memchr( p, 0, pEnd - p );
+    if (!pNul)
+      return NULL;
+    const unsigned char * pNext = p + (((pNul - p) + 4) & ~3);
+    return pNext <= pEnd ? pNext : NULL;
+  }
+
+  bool ParseMessage( const unsigned char * p, const unsigned char * pEnd )
+  {
+    const unsigned char * pTypes = SkipString( p, pEnd );
+    if (!pTypes || pTypes >= pEnd || *pTypes != ',') // messages without type tags predate OSC 1.0, nobody sends those anymore
+      return false;
+    const unsigned char * pArgs = SkipString( pTypes, pEnd );
+    if (!pArgs)
+      return false;
+
+    if (nMessageCount >= OSC_MAX_MESSAGES)
+    {
+      nOverflowCount++;
+      return true;
+    }
+    MESSAGE & message = messages[ nMessageCount++ ];
+    message.szAddress = (const char *)p;
+    message.szTypes = (const char *)pTypes + 1;
+    message.pArgs = pArgs;
+    message.pEnd = pEnd;
+    return true;
+  }
+
+  bool ParseElement( const unsigned char * p, const unsigned char * pEnd, int nDepth )
+  {
+    if (pEnd - p < 4 || ((pEnd - p) & 3))
+      return false;
+
+    if (*p == '/')
+      return ParseMessage( p, pEnd );
+
+    // "#bundle\0", an 8 byte time tag, then size-prefixed elements
+    if (pEnd - p < 16 || memcmp( p, "#bundle", 8 ) != 0 || nDepth >= OSC_MAX_BUNDLE_DEPTH)
+      return false;
+    for (p += 16; p < pEnd; )
+    {
+      if (pEnd - p < 4)
+        return false;
+      unsigned int nSize = ReadInt32( p );
+      p += 4;
+      if (nSize > (unsigned int)(pEnd - p))
+        return false;
+      if (!ParseElement( p, p + nSize, nDepth + 1 ))
+        return false;
+      p += nSize;
+    }
+    return true;
+  }
+
+  // the first argument that can be read as a number; strings and blobs before it are skipped
+  bool GetFirstNumber( const MESSAGE & message, float & fValue )
+  {
+    const unsigned char * p = message.pArgs;
+    for (const char * t = message.szTypes; *t; t++)
+    {
+      int nSize = 0;
+      switch (*t)
+      {
+        case 'f':
+          if (message.pEnd - p < 4) return false;
+          {
+            unsigned int nBits = ReadInt32( p );
+            float f;
+            memcpy( &f, &nBits, sizeof(float) );
+            fValue = f;
+          }
+          return true;
+        case 'i':
+          if (message.pEnd - p < 4) return false;
+          fValue = (float)(int)ReadInt32( p );
+          return true;
+        case 'd':
+          if (message.pEnd - p < 8) return false;
+          {
+            unsigned long long nBits = ReadInt64( p );
+            double d;
+            memcpy( &d, &nBits, sizeof(double) );
+            fValue = (float)d;
+          }
+          return true;
+        case 'h':
+          if (message.pEnd - p < 8) return false;
+          fValue = (float)(long long)ReadInt64( p );
+          return true;
+        case 'T':
+          fValue = 1.0f;
+          return true;
+        case 'F':
+          fValue = 0.0f;
+          return true;
+        case 's':
+        case 'S':
+          p = SkipString( p, message.pEnd );
+          if (!p) return false;
+          continue;
+        case 'b':
+          if (message.pEnd - p < 4) return false;
+          nSize = 4 + ((ReadInt32( p ) + 3) & ~3);
+          break;
+        case 't':
+          nSize = 8;
+          break;
+        case 'c':
+        case 'r':
+        case 'm':
+          nSize = 4;
+          break;
+        case 'N':
+        case 'I':
+        case '[':
+        case ']':
+          nSize = 0;
+          break;
+        default:
+          return false; // unknown type, so the size of what follows is unknown too
+      }
+      if (nSize < 0 || nSize > message.pEnd - p)
+        return false;
+      p += nSize;
+    }
+    return false;
+  }
+
+  void ProcessPacket( int nSize )
+  {
+    nPacketCount++;
+    nMessageCount = 0;
+    if (!ParseElement( packet, packet + nSize, 0 ))
+      nMalformedCount++;
+
+    // whatever parsed before a malformed part is still used
+    for (int i = 0; i < nMessageCount; i++)
+    {
+      int nSlot = FindSlot( messages[i].szAddress );
+      float fValue = 0.0f;
+      if (nSlot >= 0 && GetFirstNumber( messages[i], fValue ))
+        slots[nSlot].fValue.store( fValue, std::memory_order_relaxed );
+    }
+  }
+
+  void ListenerThread()
+  {
+    while (bRunning)
+    {
+      // the receive timeout is only there to notice Close()
+      int nSize = recvfrom( sock, (char *)packet, OSC_PACKET_SIZE, 0, NULL, NULL );
+      if (nSize > 0)
+        ProcessPacket( nSize );
+    }
+  }
+
+  bool Open()
+  {
+    if (!bEnabled)
+      return false;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup( MAKEWORD(2, 2), &wsaData ) != 0)
+    {
+      printf("[OSC] Cannot initialize Winsock\n");
+      return false;
+    }
+#endif
+
+    sock = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    if (sock == INVALID_SOCKET)
+    {
+      printf("[OSC] Cannot create socket\n");
+#ifdef _WIN32
+      WSACleanup();
+#endif
+      return false;
+    }
+
+    // room for a few frames' worth of bursts while the listener is busy
+    int nBufferSize = 1024 * 1024;
+    setsockopt( sock, SOL_SOCKET, SO_RCVBUF, (const char *)&nBufferSize, sizeof(nBufferSize) );
+#ifdef _WIN32
+    DWORD nTimeout = 100;
+    setsockopt( sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&nTimeout, sizeof(nTimeout) );
+#else
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    setsockopt( sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout) );
+#endif
+
+    struct sockaddr_in addr;
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_ANY );
+    addr.sin_port = htons( (unsigned short)nPort );
+    if (bind( sock, (struct sockaddr *)&addr, sizeof(addr) ) != 0)
+    {
+      printf("[OSC] Cannot bind to UDP port %d\n", nPort);
+      Close();
+      return false;
+    }
+
+    printf("[OSC] Listening on UDP port %d, %d addresses mapped\n", nPort, nSlotCount);
+    bRunning = true;
+    listenerThread = std::thread( ListenerThread );
+    return true;
+  }
+
+  void Close()
+  {
+    if (bRunning)
+    {
+      bRunning = false;
+      listenerThread.join();
+      printf("[OSC] %u packets received, %u malformed, %u messages past the per-packet limit\n", nPacketCount, nMalformedCount, nOverflowCount);
+    }
+    if (sock != INVALID_SOCKET)
+    {
+      closesocket( sock );
+      sock = INVALID_SOCKET;
+#ifdef _WIN32
+      WSACleanup();
+#endif
+    }
+  }
+
+  float GetValue( int nSlot )
+  {
+    if (nSlot < 0 || nSlot >= nSlotCount)
+      return 0.0f;
+    return slots[nSlot].fValue.load( std::memory_order_relaxed );
+  }
+}
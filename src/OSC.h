@@ -0,0 +1,15 @@
+namespace OSC
+{
+  // OSC over UDP: a listener thread parses each packet (messages and nested
+  // bundles) in place into a fixed message arena, and the first numeric
+  // argument of every message to an address registered with AddAddress() is
+  // stored in that address's slot. Slots are single atomics, latest value wins,
+  // so a burst never makes the render thread wait, it only sees the newest value.
+  // Bundle time tags are ignored; everything is applied as soon as it arrives.
+  void LoadSettings( jsonxx::Object & o );
+  bool Open(); // false if it's disabled or the port can't be bound
+  void Close();
+
+  int AddAddress( const char * szAddress ); // returns the slot, -1 if the table is full; new addresses only before Open()
+  float GetValue( int nSlot ); // safe to call while the listener is running
+}
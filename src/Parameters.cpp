@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "jsonxx.h"
+#include "MIDI.h"
+#include "OSC.h"
+#include "Parameters.h"
+#include "Renderer.h"
+
+namespace Parameters
+{
+  typedef enum
+  {
+    SOURCE_MIDI,
+    SOURCE_OSC,
+  } SOURCE_TYPE;
+
+  typedef enum
+  {
+    SMOOTHING_NONE = 0,
+    SMOOTHING_SLEW,
+    SMOOTHING_SPRING,
+    SMOOTHING_COUNT,
+  } SMOOTHING;
+
+  // everything about a parameter that isn't touched by the smoothing loops
+  struct Param
+  {
+    std::string sName;
+    SOURCE_TYPE source;
+    MIDI::Route route;
+    int nOSCSlot;
+    float fCurve; // exponent, 0 for smoothstep
+    float fMin;
+    float fMax;
+    SMOOTHING smoothing;
+    int nIndex; // into the block of its smoothing
+  };
+
+  // one block per smoothing, stored as arrays so Update() is a straight loop over each
+  struct Block
+  {
+    std::vector<float> fTarget;
+    std::vector<float> fValue;
+    std::vector<float> fVelocity; // spring only
+    std::vector<float> fRate; // slew: units per second; spring: angular frequency
+  };
+
+  std::vector<Param> params;
+  Block blocks[SMOOTHING_COUNT];
+
+  float Map( const Param & param, float fRaw )
+  {
+    float f = fRaw;
+    if (param.fCurve == 0.0f)
+    {
+      f = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+      f = f * f * (3.0f - 2.0f * f);
+    }
+    else if (param.fCurve != 1.0f)
+    {
+      // keeps the sign, so pitch bend bends the same way both sides of the center
+      f = f < 0.0f ? -powf( -f, param.fCurve ) : powf( f, param.fCurve );
+    }
+    return param.fMin + (param.fMax - param.fMin) * f;
+  }
+
+  bool ParseParam( const std::string & sName, jsonxx::Value * value, SOURCE_TYPE source )
+  {
+    Param param;
+    param.sName = sName;
+    param.source = source;
+    param.nOSCSlot = -1;
+    param.fCurve = 1.0f;
+    param.fMin = 0.0f;
+    param.fMax = 1.0f;
+    param.smoothing = SMOOTHING_NONE;
+    float fTime = 0.0f;
+
+    jsonxx::Value * sourceValue = value;
+    if (value->is<jsonxx::Object>())
+    {
+      jsonxx::Object & o = value->get<jsonxx::Object>();
+      std::map<std::string, jsonxx::Value*>::const_iterator it = o.kv_map().find("source");
+      sourceValue = it != o.kv_map().end() ? it->second : NULL;
+      if (o.has<jsonxx::Number>("curve"))
+        param.fCurve = o.get<jsonxx::Number>("curve");
+      else if (o.has<jsonxx::String>("curve") && o.get<jsonxx::String>("curve") == "smoothstep")
+        param.fCurve = 0.0f;
+      if (o.has<jsonxx::Number>("min"))
+        param.fMin = o.get<jsonxx::Number>("min");
+      if (o.has<jsonxx::Number>("max"))
+        param.fMax = o.get<jsonxx::Number>("max");
+      if (o.has<jsonxx::Number>("time"))
+        fTime = o.get<jsonxx::Number>("time");
+      if (o.has<jsonxx::String>("smoothing"))
+      {
+        std::string sSmoothing = o.get<jsonxx::String>("smoothing");
+        if (sSmoothing == "slew")
+          param.smoothing = SMOOTHING_SLEW;
+        else if (sSmoothing == "spring")
+          param.smoothing = SMOOTHING_SPRING;
+        else if (sSmoothing != "none")
+          printf("[Parameters] Unknown smoothing \"%s\" for %s\n", sSmoothing.c_str(), sName.c_str());
+      }
+      if (param.fCurve < 0.0f)
+      {
+        printf("[Parameters] The curve for %s can't be negative, using linear\n", sName.c_str());
+        param.fCurve = 1.0f;
+      }
+    }
+
+    char szSource[64];
+    if (sourceValue && sourceValue->is<jsonxx::Number>())
+      sprintf( szSource, "%d", (int)sourceValue->number_value_ );
+    else if (sourceValue && sourceValue->is<jsonxx::String>())
+      sprintf( szSource, "%.63s", sourceValue->string_value_->c_str() );
+    else
+      szSource[0] = 0;
+
+    if (source == SOURCE_MIDI && !MIDI::ParseRoute( szSource, param.route ))
+    {
+      printf("[Parameters] Unknown MIDI source \"%s\" for %s\n", szSource, sName.c_str());
+      return false;
+    }
+    if (source == SOURCE_OSC)
+    {
+      if (szSource[0] != '/')
+      {
+        printf("[Parameters] The OSC address for %s should start with '/'\n", sName.c_str());
+        return false;
+      }
+      param.nOSCSlot = OSC::AddAddress( szSource );
+      if (param.nOSCSlot < 0)
+      {
+        printf("[Parameters] No room for the OSC address of %s, or it's new since startup; it won't be mapped\n", sName.c_str());
+        return false;
+      }
+    }
+
+    if (fTime <= 0.0f)
+      param.smoothing = SMOOTHING_NONE;
+
+    Block & block = blocks[ param.smoothing ];
+    param.nIndex = block.fValue.size();
+    block.fTarget.push_back( Map( param, 0.0f ) );
+    block.fValue.push_back( Map( param, 0.0f ) );
+    block.fVelocity.push_back( 0.0f );
+    switch (param.smoothing)
+    {
+      case SMOOTHING_SLEW: block.fRate.push_back( fabsf( param.fMax - param.fMin ) / fTime ); break;
+      case SMOOTHING_SPRING: block.fRate.push_back( 4.0f / fTime ); break; // (1 + wt) * e^-wt is down to 9% at wt = 4
+      default: block.fRate.push_back( 0.0f ); break;
+    }
+    params.push_back( param );
+    return true;
+  }
+
+  // every variable has a slot in the frame constants, and the default shader's block only has so many
+  void ParseParams( const std::map<std::string, jsonxx::Value*> & kv, SOURCE_TYPE source )
+  {
+    for (std::map<std::string, jsonxx::Value*>::const_iterator it = kv.begin(); it != kv.end(); it++)
+    {
+      if (params.size() >= FRAMECONSTANTS_MAX_PARAMETERS)
+      {
+        printf("[Parameters] Only %d MIDI / OSC variables fit in the frame constants, %s is left out\n", FRAMECONSTANTS_MAX_PARAMETERS, it->first.c_str());
+        continue;
+      }
+      ParseParam( it->first, it->second, source );
+    }
+  }
+
+  void LoadSettings( jsonxx::Object & o )
+  {
+    if (o.has<jsonxx::Object>("midi"))
+      ParseParams( o.get<jsonxx::Object>("midi").kv_map(), SOURCE_MIDI );
+    if (o.has<jsonxx::Object>("osc") && o.get<jsonxx::Object>("osc").has<jsonxx::Object>("params"))
+      ParseParams( o.get<jsonxx::Object>("osc").get<jsonxx::Object>("params").kv_map(), SOURCE_OSC );
+  }
+
+  bool Reload( jsonxx::Object & o )
+  {
+    std::vector<Param> oldParams;
+    Block oldBlocks[SMOOTHING_COUNT];
+    oldParams.swap( params );
+    for (int i = 0; i < SMOOTHING_COUNT; i++)
+      std::swap( oldBlocks[i], blocks[i] );
+    LoadSettings( o );
+
+    // the shaders reach the variables by their position in the frame constants, so that has to stay put
+    bool bSameNames = params.size() == oldParams.size();
+    for (int i = 0; i < params.size() && bSameNames; i++)
+      bSameNames = params[i].sName == oldParams[i].sName;
+    if (!bSameNames)
+    {
+      printf("[Parameters] Variables were added, removed or couldn't be mapped; restart to apply that\n");
+      params.swap( oldParams );
+      for (int i = 0; i < SMOOTHING_COUNT; i++)
+        std::swap( oldBlocks[i], blocks[i] );
+      return false;
+    }
+
+    // carry on from where they were rather than jumping to the new range's minimum
+    for (int i = 0; i < params.size(); i++)
+    {
+      float fValue = oldBlocks[ oldParams[i].smoothing ].fValue[ oldParams[i].nIndex ];
+      blocks[ params[i].smoothing ].fValue[ params[i].nIndex ] = fValue;
+      blocks[ params[i].smoothing ].fTarget[ params[i].nIndex ] = fValue;
+    }
+    return true;
+  }
+
+  void Update( float fDeltaTime )
+  {
+    for (int i = 0; i < params.size(); i++)
+    {
+      const Param & param = params[i];
+      float fRaw = param.source == SOURCE_MIDI ? MIDI::GetValue( param.route ) : OSC::GetValue( param.nOSCSlot );
+      blocks[ param.smoothing ].fTarget[ param.nIndex ] = Map( param, fRaw );
+    }
+
+    Block & none = blocks[ SMOOTHING_NONE ];
+    if (none.fValue.size())
+      memcpy( &none.fValue[0], &none.fTarget[0], none.fValue.size() * sizeof(float) );
+
+    Block & slew = blocks[ SMOOTHING_SLEW ];
+    int nCount = slew.fValue.size();
+    if (nCount)
+    {
+      const float * fTarget = &slew.fTarget[0];
+      const float * fRate = &slew.fRate[0];
+      float * fValue = &slew.fValue[0];
+      for (int i = 0; i < nCount; i++)
+      {
+        float fStep = fRate[i] * fDeltaTime;
+        float fDelta = fTarget[i] - fValue[i];
+        fDelta = fDelta > fStep ? fStep : (fDelta < -fStep ? -fStep : fDelta);
+        fValue[i] += fDelta;
+      }
+    }
+
+    // critically damped spring, with e^-x approximated by a cubic so it stays stable for any frame time
+    Block & spring = blocks[ SMOOTHING_SPRING ];
+    nCount = spring.fValue.size();
+    if (nCount)
+    {
+      const float * fTarget = &spring.fTarget[0];
+      const float * fOmega = &spring.fRate[0];
+      float * fValue = &spring.fValue[0];
+      float * fVelocity = &spring.fVelocity[0];
+      for (int i = 0; i < nCount; i++)
+      {
+        float x = fOmega[i] * fDeltaTime;
+        float fDecay = 1.0f / (1.0f + x + 0.48f * x * x + 0.235f * x * x * x);
+        float fOffset = fValue[i] - fTarget[i];
+        float fTemp = (fVelocity[i] + fOmega[i] * fOffset) * fDeltaTime;
+        fVelocity[i] = (fVelocity[i] - fOmega[i] * fTemp) * fDecay;
+        fValue[i] = fTarget[i] + (fOffset + fTemp) * fDecay;
+      }
+    }
+  }
+
+  int GetCount()
+  {
+    return params.size();
+  }
+
+  const char * GetName( int nParam )
+  {
+    return params[nParam].sName.c_str();
+  }
+
+  float GetValue( int nParam )
+  {
+    return blocks[ params[nParam].smoothing ].fValue[ params[nParam].nIndex ];
+  }
+}
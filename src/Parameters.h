@@ -0,0 +1,22 @@
+namespace Parameters
+{
+  // Every shader variable driven from outside (the "midi" and "osc" sections)
+  // goes through here: the raw input is mapped through a curve onto min..max,
+  // and the variable then follows it with the chosen smoothing, so slow fader
+  // moves don't step in 1/127 increments. A source can be given as is, or as
+  //   { "source": "cc14:1", "curve": 2, "min": 0, "max": 10, "smoothing": "spring", "time": 0.2 }
+  // curve: an exponent (1 is linear, 2 starts slow, 0.5 starts fast) or "smoothstep"
+  // smoothing: "none", "slew" (crosses min..max in at most "time" seconds) or
+  // "spring" (critically damped, settles in about "time" seconds)
+  void LoadSettings( jsonxx::Object & o ); // registers the OSC addresses, so before OSC::Open()
+  void Update( float fDeltaTime ); // once per frame, after MIDI::Update()
+
+  // takes new sources, curves and smoothing from a changed config; the variables
+  // themselves have to stay the same, and OSC addresses that weren't there at
+  // startup can't be added, otherwise everything stays as it was and it's false
+  bool Reload( jsonxx::Object & o );
+
+  int GetCount();
+  const char * GetName( int nParam ); // the shader variable
+  float GetValue( int nParam );
+}
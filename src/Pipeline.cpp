@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "jsonxx.h"
+#include "Renderer.h"
+#include "Pipeline.h"
+
+namespace Pipeline
+{
+  struct PASS
+  {
+    std::string sName;
+    int nTab;
+    float fScale;
+    Renderer::RENDERTARGETFORMAT format;
+    bool bFeedback;
+    Renderer::Texture * targets[2];
+    int nLatest; // index of the target with the most recent complete output
+  };
+  std::vector<PASS> passes;
+
+  const char * szFormatNames[] = { "rgba8", "rgba16f", "rgba32f" };
+
+  void LoadSettings( jsonxx::Object & o )
+  {
+    if (!o.has<jsonxx::Array>("passes"))
+      return;
+
+    jsonxx::Array & list = o.get<jsonxx::Array>("passes");
+    for (int i = 0; i < list.size(); i++)
+    {
+      if (!list.has<jsonxx::Object>(i))
+        continue;
+      jsonxx::Object & p = list.get<jsonxx::Object>(i);
+      if (!p.has<jsonxx::String>("name") || !p.has<jsonxx::Number>("tab"))
+      {
+        printf("[Pipeline] Pass %d needs a \"name\" and a \"tab\", skipping it\n", i + 1);
+        continue;
+      }
+
+      PASS pass;
+      pass.sName = p.get<jsonxx::String>("name");
+      pass.nTab = (int)p.get<jsonxx::Number>("tab") - 1;
+      pass.fScale = p.has<jsonxx::Number>("scale") ? (float)p.get<jsonxx::Number>("scale") : 1.0f;
+      pass.format = Renderer::RENDERTARGETFORMAT_RGBA16F;
+      if (p.has<jsonxx::String>("format"))
+      {
+        std::string sFormat = p.get<jsonxx::String>("format");
+        int nFormat = 0;
+        while (nFormat < sizeof(szFormatNames) / sizeof(szFormatNames[0]) && sFormat != szFormatNames[nFormat])
+          nFormat++;
+        if (nFormat < sizeof(szFormatNames) / sizeof(szFormatNames[0]))
+          pass.format = (Renderer::RENDERTARGETFORMAT)nFormat;
+        else
+          printf("[Pipeline] Unknown format \"%s\" for pass \"%s\", using %s\n", sFormat.c_str(), pass.sName.c_str(), szFormatNames[ pass.format ]);
+      }
+      pass.bFeedback = p.has<jsonxx::Boolean>("feedback") ? p.get<jsonxx::Boolean>("feedback") : false;
+      pass.targets[0] = pass.targets[1] = NULL;
+      pass.nLatest = 0;
+      passes.push_back( pass );
+    }
+  }
+
+  bool Open( int nWidth, int nHeight, int nTabCount )
+  {
+    for (int i = 0; i < passes.size(); i++)
+    {
+      if (passes[i].nTab < 0 || passes[i].nTab >= nTabCount)
+      {
+        printf("[Pipeline] Pass \"%s\" renders tab %d, but there are only %d tabs; skipping it\n", passes[i].sName.c_str(), passes[i].nTab + 1, nTabCount);
+        passes.erase( passes.begin() + i-- );
+      }
+    }
+
+    for (int i = 0; i < passes.size(); i++)
+    {
+      PASS & pass = passes[i];
+      pass.fScale = pass.fScale < 0.01f ? 0.01f : pass.fScale > 4.0f ? 4.0f : pass.fScale;
+      int w = (int)(nWidth * pass.fScale);
+      int h = (int)(nHeight * pass.fScale);
+      w = w < 1 ? 1 : w;
+      h = h < 1 ? 1 : h;
+      for (int j = 0; j < (pass.bFeedback ? 2 : 1); j++)
+      {
+        pass.targets[j] = Renderer::CreateRenderTarget( w, h, pass.format );
+        if (!pass.targets[j])
+        {
+          printf("[Pipeline] Cannot create the %s buffers of pass \"%s\"\n", szFormatNames[ pass.format ], pass.sName.c_str());
+          Close();
+          return false;
+        }
+      }
+      printf("[Pipeline] Pass \"%s\": tab %d, %d x %d %s%s\n", pass.sName.c_str(), pass.nTab + 1, w, h, szFormatNames[ pass.format ], pass.bFeedback ? ", feedback" : "");
+    }
+    return true;
+  }
+
+  void Close()
+  {
+    for (int i = 0; i < passes.size(); i++)
+    {
+      for (int j = 0; j < 2; j++)
+      {
+        if (passes[i].targets[j])
+          Renderer::ReleaseTexture( passes[i].targets[j] );
+      }
+    }
+    passes.clear();
+  }
+
+  int GetPassCount()
+  {
+    return (int)passes.size();
+  }
+
+  int GetPassTab( int nPass )
+  {
+    return passes[nPass].nTab;
+  }
+
+  const char * GetPassName( int nPass )
+  {
+    return passes[nPass].sName.c_str();
+  }
+
+  Renderer::Texture * BeginPass( int nPass )
+  {
+    PASS & pass = passes[nPass];
+    Renderer::Texture * target = pass.bFeedback ? pass.targets[ 1 - pass.nLatest ] : pass.targets[0];
+    Renderer::SetRenderTarget( target );
+    return target;
+  }
+
+  void EndPass( int nPass )
+  {
+    if (passes[nPass].bFeedback)
+      passes[nPass].nLatest = 1 - passes[nPass].nLatest;
+  }
+
+  void EndPasses()
+  {
+    if (!passes.empty())
+      Renderer::SetRenderTarget( NULL );
+  }
+
+  void SetShaderTextures( int nCurrentPass, int nFirstName )
+  {
+    for (int i = 0; i < passes.size(); i++)
+    {
+      // a buffer can't be read while it's being written; feedback passes read their other one
+      if (i == nCurrentPass && !passes[i].bFeedback)
+        continue;
+      Renderer::SetShaderTexture( nFirstName + i, passes[i].targets[ passes[i].nLatest ] );
+    }
+  }
+}
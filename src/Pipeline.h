@@ -0,0 +1,23 @@
+namespace Pipeline
+{
+  // Offscreen passes that run before the shader on screen, each one a tab
+  // rendering into its own buffer. Every shader can sample every buffer under
+  // the pass name: passes earlier in the list give this frame's result, the
+  // pass itself and later ones the previous frame's (only kept for passes with
+  // "feedback", which ping-pong between two buffers).
+  void LoadSettings( jsonxx::Object & o );
+  bool Open( int nWidth, int nHeight, int nTabCount );
+  void Close();
+
+  int GetPassCount();
+  int GetPassTab( int nPass );
+  const char * GetPassName( int nPass );
+
+  Renderer::Texture * BeginPass( int nPass ); // binds the buffer to write, returns it for the resolution
+  void EndPass( int nPass );
+  void EndPasses(); // back to the back buffer
+
+  // bind the buffers as textures to the current shader; nCurrentPass is the pass being rendered, -1 for the screen.
+  // The pass names sit in the renderer's texture name table in pass order from nFirstName on.
+  void SetShaderTextures( int nCurrentPass, int nFirstName );
+}
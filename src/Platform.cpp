@@ -10,6 +10,8 @@
 
 #include <vector>
 #include <map>
+#include <string>
+#include <unordered_map>
 
 #include "Platform.h"
 #include "Scintilla.h"
@@ -19,6 +21,7 @@
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 #include "Renderer.h"
+#include "Misc.h"
 
 #ifdef SCI_NAMESPACE
 using namespace Scintilla;
@@ -99,16 +102,391 @@ void Platform::DebugPrintf(const char *, ...)
 //////////////////////////////////////////////////////////////////////////
 // FONT
 
-#define CHARACTER_COUNT 512 // first 512 chars of unicode should be sufficient
+#define FONT_PAGE_MIN_SIZE 256
+#define FONT_PAGE_MAX_SIZE 2048
+#define FONT_GLYPH_PADDING 1
+#define FONT_FALLBACK_CODEPOINT '?'
+
+// Glyphs are rasterised the first time they're drawn and packed into atlas
+// pages with a skyline packer; a full page is never repacked, a new one is
+// started instead.
+struct stbtt_SkylineNode
+{
+  int x, y, width;
+};
+
+struct stbtt_FontPage
+{
+  Renderer::Texture * texture;
+  std::vector<stbtt_SkylineNode> skyline;
+};
+
+struct stbtt_Glyph
+{
+  int page; // -1 for glyphs with no pixels (space)
+  int x0, y0, x1, y1; // bitmap box relative to the pen position on the baseline, in atlas pixels
+  int s, t; // top left of the bitmap in the page, in pixels
+};
+
+// In distance field mode one atlas per face is rasterised at FONT_SDF_SIZE
+// and scaled to whatever size is drawn; otherwise every size has its own.
+#define FONT_SDF_SIZE 32.0f
+#define FONT_SDF_SPREAD 4 // distance covered either side of the edge, in atlas pixels
+#define FONT_SDF_OVERSAMPLE 4
+#define FONT_SDF_PAGE_SIZE 512
+
+struct stbtt_GlyphAtlas
+{
+  float scale; // font units to atlas pixels
+  bool bDistanceField;
+  int pageSize;
+  std::vector<stbtt_FontPage> pages;
+  std::map<unsigned int, stbtt_Glyph> glyphs;
+  stbtt_Glyph * asciiGlyphs[128];
+  int refCount;
+};
+
+// Scintilla creates a Font for every style, nearly all with the same face and
+// size, so font files are mapped once and fonts (with their atlases) are
+// shared by refcount. A few unreferenced fonts are kept around so that style
+// refreshes, which release and recreate everything, don't re-rasterise.
+#define FONT_CACHE_UNUSED_MAX 4
+#define FONT_ADVANCE_TABLE_SIZE 0x300 // Latin, Latin-1, Latin Extended, IPA
+
+struct stbtt_FontFile
+{
+  const unsigned char * data;
+  size_t size;
+  int refCount;
+};
+
+// Scintilla redraws every visible line each frame, with mostly the same
+// text, so the laid out quads of each drawn string are kept per font and
+// only offset by the draw position. The cache is simply emptied when full.
+#define FONT_RUN_CACHE_MAX 2048
+
+struct stbtt_GlyphQuad
+{
+  Renderer::Texture * texture;
+  float x0, y0, x1, y1; // relative to the run origin on the baseline, in screen pixels
+  float s0, t0, s1, t1;
+};
+
+struct stbtt_GlyphRun
+{
+  std::string text; // to tell hash collisions apart
+  std::vector<stbtt_GlyphQuad> quads;
+};
 
 struct stbtt_Font
 {
   stbtt_fontinfo fontinfo;
-  stbtt_bakedchar cdata[CHARACTER_COUNT];
   float scale;
-  Renderer::Texture * texture;
+  stbtt_GlyphAtlas * atlas;
+  std::string atlasKey;
+  float atlasToScreen;
+
+  // layout only needs advances, and needs them constantly, so they're kept
+  // apart from the glyphs and never trigger rasterisation
+  float advances[FONT_ADVANCE_TABLE_SIZE]; // negative until looked up
+  std::unordered_map<unsigned int, float> rareAdvances;
+  bool hasKerning;
+  float ascent, descent, lineGap;
+
+  std::unordered_map<unsigned long long, stbtt_GlyphRun> runs; // keyed by HashText()
+
+  std::string path;
+  int refCount;
+  unsigned int lastUsed;
 };
 
+std::map<std::string, stbtt_FontFile> fontFiles;
+std::map<std::string, stbtt_GlyphAtlas*> glyphAtlases;
+std::map<std::string, stbtt_Font*> fontCache;
+unsigned int fontCacheClock = 0;
+
+static unsigned int DecodeUTF8( const char * s, int len, unsigned int & codepoint )
+{
+  const unsigned char * us = (const unsigned char *)s;
+  unsigned int charLength = UTF8CharLength( us[0] );
+  if (charLength > (unsigned int)len)
+    charLength = 1;
+
+  switch (charLength)
+  {
+    case 2: codepoint = ((us[0] & 0x1F) << 6) | (us[1] & 0x3F); break;
+    case 3: codepoint = ((us[0] & 0x0F) << 12) | ((us[1] & 0x3F) << 6) | (us[2] & 0x3F); break;
+    case 4: codepoint = ((us[0] & 0x07) << 18) | ((us[1] & 0x3F) << 12) | ((us[2] & 0x3F) << 6) | (us[3] & 0x3F); break;
+    default: codepoint = us[0]; break;
+  }
+  return charLength;
+}
+
+static unsigned int GetRenderableCodepoint( stbtt_Font * font, unsigned int c )
+{
+  if (c < 128 && font->atlas->asciiGlyphs[c])
+    return c;
+  return stbtt_FindGlyphIndex( &font->fontinfo, c ) ? c : FONT_FALLBACK_CODEPOINT;
+}
+
+static float GetAdvance( stbtt_Font * font, unsigned int c )
+{
+  float * cached = NULL;
+  if (c < FONT_ADVANCE_TABLE_SIZE)
+  {
+    if (font->advances[c] >= 0.0f)
+      return font->advances[c];
+    cached = &font->advances[c];
+  }
+  else
+  {
+    std::unordered_map<unsigned int, float>::iterator it = font->rareAdvances.find( c );
+    if (it != font->rareAdvances.end())
+      return it->second;
+    cached = &font->rareAdvances[c];
+  }
+
+  int advance = 0, leftBearing = 0;
+  stbtt_GetCodepointHMetrics( &font->fontinfo, GetRenderableCodepoint( font, c ), &advance, &leftBearing );
+  *cached = advance * font->scale;
+  return *cached;
+}
+
+// only the legacy 'kern' table is supported by stb_truetype, which
+// monospace fonts rarely have, so this is usually a single branch
+static float GetKerning( stbtt_Font * font, unsigned int prev, unsigned int c )
+{
+  if (!font->hasKerning || !prev)
+    return 0.0f;
+  return stbtt_GetCodepointKernAdvance( &font->fontinfo, GetRenderableCodepoint( font, prev ), GetRenderableCodepoint( font, c ) ) * font->scale;
+}
+
+static unsigned long long HashText( const char * s, int len )
+{
+  // FNV-1a
+  unsigned long long hash = 14695981039346656037ULL;
+  for (int i = 0; i < len; i++)
+    hash = (hash ^ (unsigned char)s[i]) * 1099511628211ULL;
+  return hash;
+}
+
+static bool SkylineFit( stbtt_FontPage & page, int index, int w, int h, int pageSize, int & y )
+{
+  int x = page.skyline[index].x;
+  if (x + w > pageSize)
+    return false;
+
+  y = 0;
+  int widthLeft = w;
+  for (int i = index; widthLeft > 0; i++)
+  {
+    if (i >= page.skyline.size())
+      return false;
+    if (page.skyline[i].y > y)
+      y = page.skyline[i].y;
+    widthLeft -= page.skyline[i].width;
+  }
+  return y + h <= pageSize;
+}
+
+static bool SkylinePack( stbtt_FontPage & page, int w, int h, int pageSize, int & outX, int & outY )
+{
+  int bestIndex = -1;
+  int bestY = pageSize;
+  int bestWidth = pageSize;
+  for (int i = 0; i < page.skyline.size(); i++)
+  {
+    int y = 0;
+    if (SkylineFit( page, i, w, h, pageSize, y ) && (y < bestY || (y == bestY && page.skyline[i].width < bestWidth)))
+    {
+      bestIndex = i;
+      bestY = y;
+      bestWidth = page.skyline[i].width;
+    }
+  }
+  if (bestIndex < 0)
+    return false;
+
+  stbtt_SkylineNode node = { page.skyline[bestIndex].x, bestY + h, w };
+  page.skyline.insert( page.skyline.begin() + bestIndex, node );
+
+  // trim / remove the segments the new node now covers
+  for (int i = bestIndex + 1; i < page.skyline.size(); i++)
+  {
+    int nodeEnd = node.x + node.width;
+    if (page.skyline[i].x >= nodeEnd)
+      break;
+    int shrink = nodeEnd - page.skyline[i].x;
+    page.skyline[i].x += shrink;
+    page.skyline[i].width -= shrink;
+    if (page.skyline[i].width > 0)
+      break;
+    page.skyline.erase( page.skyline.begin() + i );
+    i--;
+  }
+
+  // merge neighbours at the same height
+  for (int i = 0; i + 1 < page.skyline.size(); i++)
+  {
+    if (page.skyline[i].y == page.skyline[i + 1].y)
+    {
+      page.skyline[i].width += page.skyline[i + 1].width;
+      page.skyline.erase( page.skyline.begin() + i + 1 );
+      i--;
+    }
+  }
+
+  outX = node.x;
+  outY = bestY;
+  return true;
+}
+
+static bool AddFontPage( stbtt_GlyphAtlas * atlas )
+{
+  unsigned char * empty = new unsigned char[ atlas->pageSize * atlas->pageSize ];
+  memset( empty, 0, atlas->pageSize * atlas->pageSize );
+  stbtt_FontPage page;
+  page.texture = Renderer::CreateA8TextureFromData( atlas->pageSize, atlas->pageSize, empty, atlas->bDistanceField );
+  delete[] empty;
+  if (!page.texture)
+    return false;
+
+  stbtt_SkylineNode node = { 0, 0, atlas->pageSize };
+  page.skyline.push_back( node );
+  atlas->pages.push_back( page );
+  return true;
+}
+
+// Rasterises the glyph FONT_SDF_OVERSAMPLE times larger, then for every atlas
+// pixel looks for the nearest oversampled pixel on the other side of the edge.
+static unsigned char * MakeDistanceFieldBitmap( stbtt_fontinfo * fontinfo, float scale, unsigned int c, stbtt_Glyph & glyph )
+{
+  int hx0 = 0, hy0 = 0, hx1 = 0, hy1 = 0;
+  float hiScale = scale * FONT_SDF_OVERSAMPLE;
+  stbtt_GetCodepointBitmapBox( fontinfo, c, hiScale, hiScale, &hx0, &hy0, &hx1, &hy1 );
+  int hw = hx1 - hx0;
+  int hh = hy1 - hy0;
+  if (hw <= 0 || hh <= 0)
+    return NULL;
+
+  unsigned char * hiRes = new unsigned char[ hw * hh ];
+  stbtt_MakeCodepointBitmap( fontinfo, hiRes, hw, hh, hw, hiScale, hiScale, c );
+
+  glyph.x0 = (int)floorf( hx0 / (float)FONT_SDF_OVERSAMPLE ) - FONT_SDF_SPREAD;
+  glyph.y0 = (int)floorf( hy0 / (float)FONT_SDF_OVERSAMPLE ) - FONT_SDF_SPREAD;
+  glyph.x1 = (int)ceilf( hx1 / (float)FONT_SDF_OVERSAMPLE ) + FONT_SDF_SPREAD;
+  glyph.y1 = (int)ceilf( hy1 / (float)FONT_SDF_OVERSAMPLE ) + FONT_SDF_SPREAD;
+  int w = glyph.x1 - glyph.x0;
+  int h = glyph.y1 - glyph.y0;
+
+  const int radius = FONT_SDF_SPREAD * FONT_SDF_OVERSAMPLE;
+  unsigned char * bmp = new unsigned char[ w * h ];
+  for (int y = 0; y < h; y++)
+  {
+    for (int x = 0; x < w; x++)
+    {
+      // centre of this atlas pixel in the oversampled bitmap
+      float cx = (glyph.x0 + x + 0.5f) * FONT_SDF_OVERSAMPLE - hx0;
+      float cy = (glyph.y0 + y + 0.5f) * FONT_SDF_OVERSAMPLE - hy0;
+      int icx = (int)cx;
+      int icy = (int)cy;
+      bool inside = icx >= 0 && icy >= 0 && icx < hw && icy < hh && hiRes[ icy * hw + icx ] >= 0x80;
+
+      float minDistSq = (float)(radius * radius);
+      int sx0 = icx - radius < 0 ? 0 : icx - radius;
+      int sy0 = icy - radius < 0 ? 0 : icy - radius;
+      int sx1 = icx + radius > hw ? hw : icx + radius;
+      int sy1 = icy + radius > hh ? hh : icy + radius;
+      if (inside)
+      {
+        // the bitmap border counts as outside too
+        float dx = cx < hw - cx ? cx : hw - cx;
+        float dy = cy < hh - cy ? cy : hh - cy;
+        float d = dx < dy ? dx : dy;
+        if (d * d < minDistSq)
+          minDistSq = d * d;
+      }
+      for (int sy = sy0; sy < sy1; sy++)
+      {
+        float dy = sy + 0.5f - cy;
+        if (dy * dy >= minDistSq)
+          continue;
+        for (int sx = sx0; sx < sx1; sx++)
+        {
+          if ((hiRes[ sy * hw + sx ] >= 0x80) == inside)
+            continue;
+          float dx = sx + 0.5f - cx;
+          float distSq = dx * dx + dy * dy;
+          if (distSq < minDistSq)
+            minDistSq = distSq;
+        }
+      }
+
+      float dist = sqrtf( minDistSq ) / FONT_SDF_OVERSAMPLE;
+      float value = 0.5f + (inside ? dist : -dist) / (2.0f * FONT_SDF_SPREAD);
+      bmp[ y * w + x ] = (unsigned char)(value < 0.0f ? 0 : value > 1.0f ? 255 : value * 255.0f);
+    }
+  }
+
+  delete[] hiRes;
+  return bmp;
+}
+
+static const stbtt_Glyph * GetGlyph( stbtt_Font * font, unsigned int c )
+{
+  stbtt_GlyphAtlas * atlas = font->atlas;
+  if (c < 128 && atlas->asciiGlyphs[c])
+    return atlas->asciiGlyphs[c];
+
+  std::map<unsigned int, stbtt_Glyph>::iterator it = atlas->glyphs.find( c );
+  if (it != atlas->glyphs.end())
+    return &it->second;
+
+  stbtt_Glyph glyph;
+  glyph.page = -1;
+  glyph.s = glyph.t = 0;
+
+  unsigned char * bmp = NULL;
+  if (atlas->bDistanceField)
+  {
+    bmp = MakeDistanceFieldBitmap( &font->fontinfo, atlas->scale, c, glyph );
+  }
+  else
+  {
+    stbtt_GetCodepointBitmapBox( &font->fontinfo, c, atlas->scale, atlas->scale, &glyph.x0, &glyph.y0, &glyph.x1, &glyph.y1 );
+    int w = glyph.x1 - glyph.x0;
+    int h = glyph.y1 - glyph.y0;
+    if (w > 0 && h > 0)
+    {
+      bmp = new unsigned char[ w * h ];
+      stbtt_MakeCodepointBitmap( &font->fontinfo, bmp, w, h, w, atlas->scale, atlas->scale, c );
+    }
+  }
+
+  int w = glyph.x1 - glyph.x0;
+  int h = glyph.y1 - glyph.y0;
+  if (bmp && w + FONT_GLYPH_PADDING <= atlas->pageSize && h + FONT_GLYPH_PADDING <= atlas->pageSize)
+  {
+    int x = 0, y = 0;
+    bool bPacked = !atlas->pages.empty() && SkylinePack( atlas->pages.back(), w + FONT_GLYPH_PADDING, h + FONT_GLYPH_PADDING, atlas->pageSize, x, y );
+    if (!bPacked && AddFontPage( atlas ))
+      bPacked = SkylinePack( atlas->pages.back(), w + FONT_GLYPH_PADDING, h + FONT_GLYPH_PADDING, atlas->pageSize, x, y );
+    if (bPacked)
+    {
+      Renderer::UpdateA8TextureRegion( atlas->pages.back().texture, x, y, w, h, bmp );
+      glyph.page = atlas->pages.size() - 1;
+      glyph.s = x;
+      glyph.t = y;
+    }
+  }
+  delete[] bmp;
+
+  stbtt_Glyph * result = &(atlas->glyphs[c] = glyph);
+  if (c < 128)
+    atlas->asciiGlyphs[c] = result;
+  return result;
+}
+
 Font::Font() : fid(0)
 {
 }
@@ -117,40 +495,202 @@ Font::~Font()
 {
 }
 
-void Font::Create(const FontParameters &fp)
+static const stbtt_GlyphRun * GetGlyphRun( stbtt_Font * font, const char * str, int len )
 {
-  stbtt_Font* newFont = new stbtt_Font;
+  unsigned long long hash = HashText( str, len );
+  std::unordered_map<unsigned long long, stbtt_GlyphRun>::iterator it = font->runs.find( hash );
+  if (it != font->runs.end() && it->second.text.size() == len && memcmp( it->second.text.data(), str, len ) == 0)
+    return &it->second;
 
-  FILE* f = fopen(fp.faceName, "rb");
+  if (font->runs.size() >= FONT_RUN_CACHE_MAX)
+    font->runs.clear();
 
-  assert(f);
+  stbtt_GlyphRun & run = font->runs[ hash ];
+  run.text.assign( str, len );
+  run.quads.clear();
 
-  fseek(f, 0, SEEK_END);
-  size_t len = ftell(f);
-  fseek(f, 0, SEEK_SET);
+  stbtt_GlyphAtlas * atlas = font->atlas;
+  float k = font->atlasToScreen;
+  float x = 0.0f;
+  unsigned int prev = 0;
+  while (len > 0)
+  {
+    unsigned int c = 0;
+    unsigned int charLength = DecodeUTF8( str, len, c );
+    x += GetKerning( font, prev, c );
 
-  int texSize = 512;
-  unsigned char* buf = (unsigned char*)malloc(len);
-  fread(buf, 1, len, f);
-  fclose(f);
+    const stbtt_Glyph * glyph = GetGlyph( font, GetRenderableCodepoint( font, c ) );
+    if (glyph->page >= 0)
+    {
+      stbtt_GlyphQuad quad;
+      quad.texture = atlas->pages[ glyph->page ].texture;
+      quad.x0 = x + glyph->x0 * k;
+      quad.y0 = glyph->y0 * k;
+      quad.x1 = x + glyph->x1 * k;
+      quad.y1 = glyph->y1 * k;
+      quad.s0 = glyph->s / (float)quad.texture->width;
+      quad.t0 = glyph->t / (float)quad.texture->height;
+      quad.s1 = (glyph->s + glyph->x1 - glyph->x0) / (float)quad.texture->width;
+      quad.t1 = (glyph->t + glyph->y1 - glyph->y0) / (float)quad.texture->height;
+      run.quads.push_back( quad );
+    }
 
-  unsigned char* bmp = new unsigned char[texSize*texSize];
+    x += GetAdvance( font, c );
+    prev = c;
+    str += charLength;
+    len -= charLength;
+  }
+  return &run;
+}
 
-  stbtt_BakeFontBitmap(buf, 0, fp.size, bmp, texSize, texSize, 0, CHARACTER_COUNT, newFont->cdata); // no guarantee this fits!
+static const unsigned char * AcquireFontFile( const char * path )
+{
+  std::map<std::string, stbtt_FontFile>::iterator it = fontFiles.find( path );
+  if (it != fontFiles.end())
+  {
+    it->second.refCount++;
+    return it->second.data;
+  }
 
-#ifdef _DEBUG
-  FILE* dump = fopen("font.raw", "wb");
-  fwrite(bmp,texSize,texSize,dump);
-  fclose(dump);
-#endif // _DEBUG
+  stbtt_FontFile file;
+  file.data = (const unsigned char *)Misc::MapFile( path, file.size );
+  if (!file.data)
+    return NULL;
+  file.refCount = 1;
+  fontFiles[ path ] = file;
+  return file.data;
+}
 
-  newFont->texture = Renderer::CreateA8TextureFromData( texSize, texSize, bmp );
+static void ReleaseFontFile( const std::string & path )
+{
+  std::map<std::string, stbtt_FontFile>::iterator it = fontFiles.find( path );
+  if (it == fontFiles.end() || --it->second.refCount > 0)
+    return;
+
+  Misc::UnmapFile( it->second.data, it->second.size );
+  fontFiles.erase( it );
+}
+
+static stbtt_GlyphAtlas * AcquireGlyphAtlas( const std::string & key, float scale, bool bDistanceField, int pageSize )
+{
+  std::map<std::string, stbtt_GlyphAtlas*>::iterator it = glyphAtlases.find( key );
+  if (it != glyphAtlases.end())
+  {
+    it->second->refCount++;
+    return it->second;
+  }
 
-  stbtt_InitFont(&newFont->fontinfo, buf, 0);
+  stbtt_GlyphAtlas * atlas = new stbtt_GlyphAtlas;
+  atlas->scale = scale;
+  atlas->bDistanceField = bDistanceField;
+  atlas->pageSize = pageSize;
+  atlas->refCount = 1;
+  memset(atlas->asciiGlyphs, 0, sizeof(atlas->asciiGlyphs));
+  glyphAtlases[ key ] = atlas;
+  return atlas;
+}
+
+static void ReleaseGlyphAtlas( const std::string & key )
+{
+  std::map<std::string, stbtt_GlyphAtlas*>::iterator it = glyphAtlases.find( key );
+  if (it == glyphAtlases.end() || --it->second->refCount > 0)
+    return;
+
+  for (int i = 0; i < it->second->pages.size(); i++)
+    Renderer::ReleaseTexture( it->second->pages[i].texture );
+  delete it->second;
+  glyphAtlases.erase( it );
+}
+
+static void DestroyFont( stbtt_Font * font )
+{
+  ReleaseGlyphAtlas( font->atlasKey );
+  ReleaseFontFile( font->path );
+  delete font;
+}
+
+static void TrimFontCache()
+{
+  while (true)
+  {
+    int unusedCount = 0;
+    std::map<std::string, stbtt_Font*>::iterator oldest = fontCache.end();
+    for (std::map<std::string, stbtt_Font*>::iterator it = fontCache.begin(); it != fontCache.end(); it++)
+    {
+      if (it->second->refCount)
+        continue;
+      unusedCount++;
+      if (oldest == fontCache.end() || it->second->lastUsed < oldest->second->lastUsed)
+        oldest = it;
+    }
+    if (unusedCount <= FONT_CACHE_UNUSED_MAX)
+      break;
+
+    DestroyFont( oldest->second );
+    fontCache.erase( oldest );
+  }
+}
+
+void Font::Create(const FontParameters &fp)
+{
+  bool bDistanceField = fp.technology == Renderer::TEXT_TECHNOLOGY_DISTANCEFIELD;
+
+  char szSize[32];
+  sprintf(szSize, "@%g", fp.size);
+  std::string cacheKey = std::string(fp.faceName) + szSize + (bDistanceField ? "@sdf" : "");
+
+  std::map<std::string, stbtt_Font*>::iterator it = fontCache.find( cacheKey );
+  if (it != fontCache.end())
+  {
+    it->second->refCount++;
+    it->second->lastUsed = ++fontCacheClock;
+    fid = it->second;
+    return;
+  }
+
+  const unsigned char * data = AcquireFontFile( fp.faceName );
+
+  assert(data);
+
+  stbtt_Font* newFont = new stbtt_Font;
+  stbtt_InitFont(&newFont->fontinfo, data, 0);
 
   newFont->scale = stbtt_ScaleForPixelHeight(&newFont->fontinfo, fp.size);
 
-  delete [] bmp;
+  if (bDistanceField)
+  {
+    newFont->atlasKey = std::string(fp.faceName) + "@sdf";
+    newFont->atlas = AcquireGlyphAtlas( newFont->atlasKey, stbtt_ScaleForPixelHeight(&newFont->fontinfo, FONT_SDF_SIZE), true, FONT_SDF_PAGE_SIZE );
+  }
+  else
+  {
+    // a page roughly big enough for ASCII and a bit of Latin-1 at this size
+    int cellSize = (int)(fp.size * 1.25f) + FONT_GLYPH_PADDING;
+    int pageSize = FONT_PAGE_MIN_SIZE;
+    while (pageSize < FONT_PAGE_MAX_SIZE && (pageSize / cellSize) * (pageSize / cellSize) < 192)
+      pageSize *= 2;
+
+    newFont->atlasKey = cacheKey;
+    newFont->atlas = AcquireGlyphAtlas( newFont->atlasKey, newFont->scale, false, pageSize );
+  }
+  newFont->atlasToScreen = newFont->scale / newFont->atlas->scale;
+
+  int ascent = 0, descent = 0, lineGap = 0;
+  stbtt_GetFontVMetrics(&newFont->fontinfo, &ascent, &descent, &lineGap);
+  newFont->ascent = ascent * newFont->scale;
+  newFont->descent = -descent * newFont->scale;
+  newFont->lineGap = lineGap * newFont->scale;
+  newFont->hasKerning = newFont->fontinfo.kern != 0;
+
+  for (int i = 0; i < FONT_ADVANCE_TABLE_SIZE; i++)
+    newFont->advances[i] = -1.0f;
+  for (int i = 32; i < 127; i++)
+    GetAdvance(newFont, i);
+
+  newFont->path = fp.faceName;
+  newFont->refCount = 1;
+  newFont->lastUsed = ++fontCacheClock;
+  fontCache[ cacheKey ] = newFont;
 
   fid = newFont;
 }
@@ -159,9 +699,10 @@ void Font::Release()
 {
   if (fid)
   {
-    free(((stbtt_Font*)fid)->fontinfo.data);
-    Renderer::ReleaseTexture( ((stbtt_Font*)fid)->texture );
-    delete (stbtt_Font*)fid;
+    stbtt_Font* realFont = (stbtt_Font*)fid;
+    realFont->refCount--;
+    fid = 0;
+    TrimFontCache();
   }
 }
 
@@ -377,31 +918,34 @@ void SurfaceImpl::Copy( PRectangle rc, Point from, Surface &surfaceSource )
 void SurfaceImpl::DrawTextBase(PRectangle rc, Font &font, float ybase, const char *str, int len, ColourDesired fore) 
 {
   stbtt_Font* realFont = (stbtt_Font*)font.GetID();
+  const stbtt_GlyphRun * run = GetGlyphRun( realFont, str, len );
 
-  Renderer::BindTexture( realFont->texture );
-  float x = rc.left, y = ybase;
-  while (len-- > 0) 
+  // bitmap glyphs are snapped to whole pixels; distance field quads are
+  // scaled anyway and the shader antialiases the edge
+  bool bSnap = !realFont->atlas->bDistanceField;
+  for (int i = 0; i < run->quads.size(); i++)
   {
-    unsigned int c = *str;
-    unsigned int charLength = UTF8CharLength(c);
-    if (charLength > 1)
+    const stbtt_GlyphQuad & quad = run->quads[i];
+    Renderer::BindTexture( quad.texture );
+
+    float x0 = rc.left + quad.x0;
+    float y0 = ybase + quad.y0;
+    float x1 = rc.left + quad.x1;
+    float y1 = ybase + quad.y1;
+    if (bSnap)
     {
-      c = 0;
-      UTF16FromUTF8( str, charLength, (wchar_t*)&c, sizeof(unsigned int) );
+      x0 = floorf( x0 + 0.5f );
+      y0 = floorf( y0 + 0.5f );
+      x1 = x0 + (quad.x1 - quad.x0);
+      y1 = y0 + (quad.y1 - quad.y0);
     }
-    if (c >= CHARACTER_COUNT)
-      c = '?';
-    stbtt_aligned_quad quad;
-    stbtt_GetBakedQuad( realFont->cdata, realFont->texture->width, realFont->texture->height, c, &x, &y, &quad, 1 );
-    
+
     Renderer::RenderQuad(
-      Renderer::Vertex( quad.x0, quad.y0, fore.AsLong(), quad.s0, quad.t0 ),
-      Renderer::Vertex( quad.x1, quad.y0, fore.AsLong(), quad.s1, quad.t0 ),
-      Renderer::Vertex( quad.x1, quad.y1, fore.AsLong(), quad.s1, quad.t1 ),
-      Renderer::Vertex( quad.x0, quad.y1, fore.AsLong(), quad.s0, quad.t1 )
+      Renderer::Vertex( x0, y0, fore.AsLong(), quad.s0, quad.t0 ),
+      Renderer::Vertex( x1, y0, fore.AsLong(), quad.s1, quad.t0 ),
+      Renderer::Vertex( x1, y1, fore.AsLong(), quad.s1, quad.t1 ),
+      Renderer::Vertex( x0, y1, fore.AsLong(), quad.s0, quad.t1 )
     );
-    str += charLength;
-    len -= charLength - 1;
   }
 }
 
@@ -428,29 +972,20 @@ void SurfaceImpl::MeasureWidths(Font & font, const char *str, int len, float *po
   stbtt_Font* realFont = (stbtt_Font*)font.GetID();
   
   float position = 0;
+  unsigned int prev = 0;
   const char * p = str;
-  while (len-- > 0) 
+  while (len > 0) 
   {
-    unsigned int c = *p;
-    unsigned int charLength = UTF8CharLength(c);
-    if (charLength > 1)
-    {
-      c = 0;
-      UTF16FromUTF8( str, charLength, (wchar_t*)&c, sizeof(unsigned int) );
-    }
-    if (c >= CHARACTER_COUNT)
-      c = '?';
-
-    int advance = 0, leftBearing = 0;
-    
-    stbtt_GetCodepointHMetrics(&realFont->fontinfo, c, &advance, &leftBearing);
-    
-    position     += advance;
+    unsigned int c = 0;
+    unsigned int charLength = DecodeUTF8( p, len, c );
+
+    position += GetKerning( realFont, prev, c ) + GetAdvance( realFont, c );
+    prev = c;
     for (unsigned int i=0; i<charLength; i++) // we need to loop here because UTF8 characters count as multiple unless their position is the same
-      *positions++  = position*realFont->scale;
+      *positions++ = position;
 
     p += charLength;
-    len -= charLength - 1;
+    len -= charLength;
   }
 }
 
@@ -459,50 +994,34 @@ float SurfaceImpl::WidthText(Font & font, const char *str, int len)
   stbtt_Font* realFont = (stbtt_Font*)font.GetID();
   
   float position = 0;
-  while (len-- > 0) 
+  unsigned int prev = 0;
+  while (len > 0) 
   {
-    unsigned int c = *str;
-    unsigned int charLength = UTF8CharLength(c);
-    if (charLength > 1)
-    {
-      c = 0;
-      UTF16FromUTF8( str, charLength, (wchar_t*)&c, sizeof(unsigned int) );
-    }
-    if (c >= CHARACTER_COUNT)
-      c = '?';
+    unsigned int c = 0;
+    unsigned int charLength = DecodeUTF8( str, len, c );
 
-    int advance = 0, leftBearing = 0;
-    stbtt_GetCodepointHMetrics(&realFont->fontinfo, c, &advance, &leftBearing);
-    position += advance*realFont->scale;//TODO: +Kerning
+    position += GetKerning( realFont, prev, c ) + GetAdvance( realFont, c );
+    prev = c;
 
     str += charLength;
-    len -= charLength - 1;
+    len -= charLength;
   }
   return position;
 }
 
 float SurfaceImpl::WidthChar(Font &font, char ch)
 {
-  stbtt_Font* realFont = (stbtt_Font*)font.GetID();
-  int advance, leftBearing;
-  stbtt_GetCodepointHMetrics(&realFont->fontinfo, ch, &advance, &leftBearing);
-  return advance * realFont->scale;
+  return GetAdvance( (stbtt_Font*)font.GetID(), (unsigned char)ch );
 }
 
 float SurfaceImpl::Ascent(Font &font)
 {
-  stbtt_Font* realFont = (stbtt_Font*)font.GetID();
-  int ascent, descent, lineGap;
-  stbtt_GetFontVMetrics(&realFont->fontinfo, &ascent, &descent, &lineGap);
-  return ascent * realFont->scale;
+  return ((stbtt_Font*)font.GetID())->ascent;
 }
 
 float SurfaceImpl::Descent(Font &font)
 {
-  stbtt_Font* realFont = (stbtt_Font*)font.GetID();
-  int ascent, descent, lineGap;
-  stbtt_GetFontVMetrics(&realFont->fontinfo, &ascent, &descent, &lineGap);
-  return -descent * realFont->scale;
+  return ((stbtt_Font*)font.GetID())->descent;
 }
 
 float SurfaceImpl::InternalLeading(Font &)
@@ -514,10 +1033,7 @@ float SurfaceImpl::InternalLeading(Font &)
 float SurfaceImpl::ExternalLeading(Font& font)
 {
   //WTF is this?????
-  stbtt_Font* realFont = (stbtt_Font*)font.GetID();
-  int ascent, descent, lineGap;
-  stbtt_GetFontVMetrics(&realFont->fontinfo, &ascent, &descent, &lineGap);
-  return lineGap * realFont->scale;
+  return ((stbtt_Font*)font.GetID())->lineGap;
 }
 
 float SurfaceImpl::Height(Font &font)
@@ -569,15 +1085,21 @@ bool Window::HasFocus()
   return false;
 }
 
-std::map<Scintilla::WindowID,Scintilla::PRectangle> rects;
+// the window IDs are small sequential numbers handed out by ShaderEditor, so the
+// rectangles are indexed by them directly instead of looked up every paint
+std::vector<Scintilla::PRectangle> rects;
 PRectangle Window::GetPosition() 
 {
-  return rects[wid];
+  size_t nIndex = (size_t)wid;
+  return nIndex < rects.size() ? rects[nIndex] : PRectangle();
 }
 
 void Window::SetPosition(PRectangle rc) 
 {
-  rects[wid] = rc;
+  size_t nIndex = (size_t)wid;
+  if (nIndex >= rects.size())
+    rects.resize( nIndex + 1 );
+  rects[nIndex] = rc;
 }
 
 void Window::SetPositionRelative(PRectangle rc, Window w)
@@ -586,7 +1108,8 @@ void Window::SetPositionRelative(PRectangle rc, Window w)
 
 PRectangle Window::GetClientPosition() 
 {
-  return PRectangle( 0, 0, rects[wid].Width(), rects[wid].Height() );
+  PRectangle rc = GetPosition();
+  return PRectangle( 0, 0, rc.Width(), rc.Height() );
 }
 
 void Window::Show(bool show)
@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include "jsonxx.h"
+#include "Misc.h"
+#include "Preprocessor.h"
+
+#define PREPROCESSOR_MAX_DEPTH 32
+
+namespace Preprocessor
+{
+  struct INCLUDE
+  {
+    int nLine; // 0-based
+    std::string sName;
+    bool bSystem; // <file> rather than "file"
+  };
+
+  struct PARSED
+  {
+    std::string sText;
+    std::vector<size_t> lineStarts;
+    std::vector<INCLUDE> includes; // in line order
+    int nPragmaOnceLine; // -1 if none
+  };
+
+  struct CachedFile
+  {
+    unsigned long long nSize;
+    unsigned long long nModified;
+    unsigned long long nHash;
+    PARSED parsed;
+  };
+
+  std::vector<std::string> libraryPaths;
+  std::map<std::string, CachedFile> cache; // keyed by the resolved path
+
+  void LoadSettings( jsonxx::Object & o )
+  {
+    if (o.has<jsonxx::String>("shaderLibrary"))
+      libraryPaths.push_back( o.get<jsonxx::String>("shaderLibrary") );
+    if (o.has<jsonxx::Array>("shaderLibrary"))
+    {
+      jsonxx::Array & paths = o.get<jsonxx::Array>("shaderLibrary");
+      for (int i = 0; i < paths.size(); i++)
+      {
+        if (paths.has<jsonxx::String>(i))
+          libraryPaths.push_back( paths.get<jsonxx::String>(i) );
+      }
+    }
+  }
+
+  unsigned long long Hash( const char * p, size_t nSize )
+  {
+    unsigned long long nHash = 14695981039346656037ull;
+    for (size_t i = 0; i < nSize; i++)
+    {
+      nHash ^= (unsigned char)p[i];
+      nHash *= 1099511628211ull;
+    }
+    return nHash;
+  }
+
+  // "#  include" style whitespace is allowed, comments around the directive aren't looked at
+  const char * SkipSpaces( const char * p, const char * pEnd )
+  {
+    while (p < pEnd && (*p == ' ' || *p == '\t'))
+      p++;
+    return p;
+  }
+
+  bool MatchWord( const char * & p, const char * pEnd, const char * szWord )
+  {
+    size_t nLength = strlen( szWord );
+    if (pEnd - p < nLength || strncmp( p, szWord, nLength ))
+      return false;
+    p += nLength;
+    return true;
+  }
+
+  void Parse( const char * szText, size_t nSize, PARSED & parsed )
+  {
+    parsed.sText.assign( szText, nSize );
+    parsed.lineStarts.clear();
+    parsed.includes.clear();
+    parsed.nPragmaOnceLine = -1;
+
+    const char * pText = parsed.sText.c_str();
+    size_t nStart = 0;
+    while (nStart < nSize || parsed.lineStarts.empty())
+    {
+      const char * pLineEnd = (const char *)memchr( pText + nStart, '\n', nSize - nStart );
+      size_t nEnd = pLineEnd ? pLineEnd - pText : nSize;
+      int nLine = parsed.lineStarts.size();
+      parsed.lineStarts.push_back( nStart );
+
+      const char * p = SkipSpaces( pText + nStart, pText + nEnd );
+      if (p < pText + nEnd && *p == '#')
+      {
+        p = SkipSpaces( p + 1, pText + nEnd );
+        if (MatchWord( p, pText + nEnd, "include" ))
+        {
+          p = SkipSpaces( p, pText + nEnd );
+          char cClose = p < pText + nEnd ? (*p == '"' ? '"' : *p == '<' ? '>' : 0) : 0;
+          const char * pClose = cClose ? (const char *)memchr( p + 1, cClose, pText + nEnd - p - 1 ) : NULL;
+          if (pClose)
+          {
+            INCLUDE include;
+            include.nLine = nLine;
+            include.sName.assign( p + 1, pClose - p - 1 );
+            include.bSystem = cClose == '>';
+            parsed.includes.push_back( include );
+          }
+        }
+        else if (MatchWord( p, pText + nEnd, "pragma" ))
+        {
+          p = SkipSpaces( p, pText + nEnd );
+          if (MatchWord( p, pText + nEnd, "once" ))
+            parsed.nPragmaOnceLine = nLine;
+        }
+      }
+      nStart = nEnd + 1;
+    }
+  }
+
+  // stats the file every time, and only reads it again if the stamp moved
+  CachedFile * LoadFile( const std::string & sPath )
+  {
+    unsigned long long nSize = 0;
+    unsigned long long nModified = 0;
+    if (!Misc::GetFileStamp( sPath.c_str(), nSize, nModified ))
+      return NULL;
+
+    std::map<std::string, CachedFile>::iterator it = cache.find( sPath );
+    if (it != cache.end() && it->second.nSize == nSize && it->second.nModified == nModified)
+      return &it->second;
+
+    size_t nMappedSize = 0;
+    const char * pData = nSize ? (const char *)Misc::MapFile( sPath.c_str(), nMappedSize ) : "";
+    if (!pData)
+      return NULL;
+
+    CachedFile & file = cache[ sPath ];
+    file.nSize = nSize;
+    file.nModified = nModified;
+    unsigned long long nHash = Hash( pData, nMappedSize );
+    if (it == cache.end() || file.nHash != nHash) // touched but not changed keeps the parse
+    {
+      file.nHash = nHash;
+      Parse( pData, nMappedSize, file.parsed );
+    }
+    if (nMappedSize)
+      Misc::UnmapFile( pData, nMappedSize );
+    return &file;
+  }
+
+  std::string GetDirectory( const std::string & sPath )
+  {
+    size_t nSlash = sPath.find_last_of( "/\\" );
+    return nSlash == std::string::npos ? std::string() : sPath.substr( 0, nSlash + 1 );
+  }
+
+  bool Resolve( const INCLUDE & include, const std::string & sIncluder, std::string & sPath )
+  {
+    if (!include.bSystem)
+    {
+      sPath = GetDirectory( sIncluder ) + include.sName;
+      if (Misc::FileExists( sPath.c_str() ))
+        return true;
+    }
+    for (int i = 0; i < libraryPaths.size(); i++)
+    {
+      const std::string & sDirectory = libraryPaths[i];
+      bool bSlash = sDirectory.size() && (sDirectory[ sDirectory.size() - 1 ] == '/' || sDirectory[ sDirectory.size() - 1 ] == '\\');
+      sPath = sDirectory + (bSlash ? "" : "/") + include.sName;
+      if (Misc::FileExists( sPath.c_str() ))
+        return true;
+    }
+    return false;
+  }
+
+  struct STATE
+  {
+    OUTPUT * output;
+    std::vector<std::string> stack; // the includes being expanded, to catch cycles
+    std::set<std::string> once; // files with #pragma once that are already in
+    std::string * sError;
+  };
+
+  bool Expand( const PARSED & parsed, int nFile, STATE & state )
+  {
+    OUTPUT & output = *state.output;
+    std::string sPath = output.files[ nFile ]; // a copy, the includes below grow the list
+    if (parsed.nPragmaOnceLine >= 0)
+      state.once.insert( sPath );
+
+    int nInclude = 0;
+    for (int i = 0; i < parsed.lineStarts.size(); i++)
+    {
+      size_t nStart = parsed.lineStarts[i];
+      size_t nEnd = i + 1 < parsed.lineStarts.size() ? parsed.lineStarts[i + 1] : parsed.sText.size();
+
+      if (nInclude < parsed.includes.size() && parsed.includes[ nInclude ].nLine == i)
+      {
+        const INCLUDE & include = parsed.includes[ nInclude++ ];
+        char szLocation[32];
+        sprintf( szLocation, "(%d): ", i + 1 );
+
+        std::string sIncludePath;
+        if (!Resolve( include, sPath, sIncludePath ))
+        {
+          *state.sError = sPath + szLocation + "cannot find include \"" + include.sName + "\"";
+          return false;
+        }
+        if (std::find( state.stack.begin(), state.stack.end(), sIncludePath ) != state.stack.end() || state.stack.size() >= PREPROCESSOR_MAX_DEPTH)
+        {
+          *state.sError = sPath + szLocation + "\"" + include.sName + "\" includes itself";
+          return false;
+        }
+        if (state.once.count( sIncludePath ))
+          continue;
+
+        CachedFile * file = LoadFile( sIncludePath );
+        if (!file)
+        {
+          *state.sError = sPath + szLocation + "cannot read \"" + sIncludePath + "\"";
+          return false;
+        }
+
+        int nIncludeFile = std::find( output.files.begin(), output.files.end(), sIncludePath ) - output.files.begin();
+        if (nIncludeFile == output.files.size())
+          output.files.push_back( sIncludePath );
+
+        state.stack.push_back( sIncludePath );
+        bool bResult = Expand( file->parsed, nIncludeFile, state );
+        state.stack.pop_back();
+        if (!bResult)
+          return false;
+        continue;
+      }
+
+      LOCATION location;
+      location.nFile = nFile;
+      location.nLine = i + 1;
+      output.lines.push_back( location );
+      if (i == parsed.nPragmaOnceLine)
+        output.sText += '\n'; // not every compiler knows it
+      else
+        output.sText.append( parsed.sText, nStart, nEnd - nStart );
+      if (!output.sText.size() || output.sText[ output.sText.size() - 1 ] != '\n')
+        output.sText += '\n';
+    }
+    return true;
+  }
+
+  bool Process( const char * szSource, const std::string & sFilename, OUTPUT & output, std::string & sError )
+  {
+    output.sText.clear();
+    output.files.clear();
+    output.lines.clear();
+    output.files.push_back( sFilename );
+
+    PARSED parsed;
+    Parse( szSource, strlen( szSource ), parsed );
+    output.sText.reserve( parsed.sText.size() );
+
+    STATE state;
+    state.output = &output;
+    state.sError = &sError;
+    state.stack.push_back( sFilename );
+    return Expand( parsed, 0, state );
+  }
+
+  // the line number is the first one following a '(' or ':' and followed by one of ")(,:", which
+  // covers "0(12) :" (NVIDIA), "0:12(5):" (Mesa), "ERROR: 0:12:" (AMD, Intel) and "(12,5):" (D3D)
+  bool FindLineNumber( const std::string & sLine, size_t & nStart, size_t & nEnd )
+  {
+    for (size_t i = 0; i + 1 < sLine.size(); i++)
+    {
+      if ((sLine[i] != '(' && sLine[i] != ':') || !isdigit( (unsigned char)sLine[i + 1] ))
+        continue;
+      size_t j = i + 1;
+      while (j < sLine.size() && isdigit( (unsigned char)sLine[j] ))
+        j++;
+      if (j < sLine.size() && strchr( ")(,:", sLine[j] ))
+      {
+        nStart = i + 1;
+        nEnd = j;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void MapErrors( const OUTPUT & output, std::string & sErrors )
+  {
+    if (output.files.size() < 2)
+      return; // nothing was included, the lines are the editor's
+
+    std::string sMapped;
+    size_t nStart = 0;
+    while (nStart < sErrors.size())
+    {
+      size_t nEnd = sErrors.find( '\n', nStart );
+      nEnd = nEnd == std::string::npos ? sErrors.size() : nEnd + 1;
+      std::string sLine = sErrors.substr( nStart, nEnd - nStart );
+      nStart = nEnd;
+
+      size_t nNumberStart = 0;
+      size_t nNumberEnd = 0;
+      if (FindLineNumber( sLine, nNumberStart, nNumberEnd ))
+      {
+        int nLine = atoi( sLine.c_str() + nNumberStart );
+        if (nLine >= 1 && nLine <= output.lines.size())
+        {
+          const LOCATION & location = output.lines[ nLine - 1 ];
+          char szLine[16];
+          sprintf( szLine, "%d", location.nLine );
+          sLine.replace( nNumberStart, nNumberEnd - nNumberStart, szLine );
+          if (location.nFile)
+            sLine = output.files[ location.nFile ] + ": " + sLine;
+        }
+      }
+      sMapped += sLine;
+    }
+    sErrors.swap( sMapped );
+  }
+
+  bool Refresh( const std::string & sPath )
+  {
+    std::map<std::string, CachedFile>::iterator it = cache.find( sPath );
+    if (it == cache.end())
+      return false; // nobody includes it
+
+    unsigned long long nHash = it->second.nHash;
+    CachedFile * file = LoadFile( sPath );
+    return !file || file->nHash != nHash;
+  }
+}
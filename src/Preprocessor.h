@@ -0,0 +1,37 @@
+#include <string>
+#include <vector>
+
+namespace Preprocessor
+{
+  // Resolves #include "file" (next to the including file first, then the
+  // library paths) and #include <file> (library paths only) before the shader
+  // goes to the compiler, since neither GLSL nor our HLSL compile calls do it.
+  // Included files are kept parsed in memory and only re-read when their size or
+  // modification time changes; #pragma once skips a file that's already in.
+  // Every output line remembers where it came from, so compile errors can be
+  // pointed back at the right file and line.
+  struct LOCATION
+  {
+    int nFile; // into OUTPUT::files
+    int nLine; // 1-based
+  };
+
+  struct OUTPUT
+  {
+    std::string sText;
+    std::vector<std::string> files; // [0] is the shader itself, the rest are the files it depends on
+    std::vector<LOCATION> lines; // one per line of sText
+  };
+
+  void LoadSettings( jsonxx::Object & o );
+
+  // false if an include is missing or recursive; sError then says where
+  bool Process( const char * szSource, const std::string & sFilename, OUTPUT & output, std::string & sError );
+
+  // rewrites the line numbers in compiler messages about the expanded text into the ones in the original files
+  void MapErrors( const OUTPUT & output, std::string & sErrors );
+
+  // re-reads a cached include that changed on disk; true if its contents are different,
+  // i.e. the shaders depending on it need recompiling
+  bool Refresh( const std::string & sPath );
+}
@@ -1,3 +1,5 @@
+#include <string>
+#include <vector>
 #include <Platform.h>
 
 typedef enum {
@@ -6,18 +8,28 @@ typedef enum {
   RENDERER_WINDOWMODE_BORDERLESS
 } RENDERER_WINDOWMODE;
 
+typedef enum {
+  RENDERER_FRAMEPACING_UNCAPPED = 0, // as fast as possible, tearing allowed
+  RENDERER_FRAMEPACING_VSYNC,        // wait for vertical blank
+  RENDERER_FRAMEPACING_FIXED,        // no vsync, limited to fTargetFrameRate by FramePacing
+  RENDERER_FRAMEPACING_ADAPTIVE      // vsync, but late frames are shown immediately instead of waiting another refresh
+} RENDERER_FRAMEPACING;
+
 typedef struct 
 {
   int nWidth;
   int nHeight;
   RENDERER_WINDOWMODE windowMode;
-  bool bVsync;
+  bool bVsync; // mirrors framePacing for the setup dialog
+  RENDERER_FRAMEPACING framePacing;
+  float fTargetFrameRate;
 } RENDERER_SETTINGS;
 
 namespace Renderer
 {
   extern const char * defaultShaderFilename;
-  extern const char defaultShader[65536];
+  extern const char * defaultShader;
+  extern const char * transitionShaderTemplate; // see Compositor.cpp for what replaces {%transition%}
 
   extern int nWidth;
   extern int nHeight;
@@ -31,10 +43,44 @@ namespace Renderer
 
   void RenderFullscreenQuad();
 
-  bool ReloadShader( const char * szShaderCode, int nShaderCodeSize, char * szErrorBuffer, int nErrorBufferSize );
+  // A compiled pixel shader; any number of them can be kept around, but the
+  // constant / texture setters and RenderFullscreenQuad() act on the one
+  // selected with SetShader().
+  struct Shader
+  {
+  };
+  Shader * CompileShader( const char * szShaderCode, int nShaderCodeSize, std::string & sError ); // NULL on error, with the compiler output in sError
+  void SetShader( Shader * shader );
+  void ReleaseShader( Shader * shader );
+  void SetShaderConstant( const char * szConstName, int x );
   void SetShaderConstant( const char * szConstName, float x );
   void SetShaderConstant( const char * szConstName, float x, float y );
 
+  // Everything the shader on screen and the passes get from outside, packed
+  // into one block declared by the default shader (std140 on GL, a cbuffer on
+  // DX11, float4 registers from c0 on DX9), so it's written to the GPU in one go
+  // instead of one uniform update per variable.
+#define FRAMECONSTANTS_MAX_PARAMETERS 64
+  struct FrameConstants
+  {
+    float fGlobalTime;
+    float fFrameTime;
+    float v2GlobalTime[2];
+    float v2Resolution[2];
+    int nFrameIndex;
+    float fPadding;
+    float v4FFTBands[4];
+    float fParameters[FRAMECONSTANTS_MAX_PARAMETERS]; // in the order of the {%midi:name%} tokens
+  };
+  // Uploads the block for the current shader, unless it's the same as last
+  // time; false if the shader doesn't declare the block (it was written before
+  // the block existed), and the caller should set the loose constants instead.
+  bool SetFrameConstants( const FrameConstants & constants );
+
+  // Scintilla technology value that makes Platform.cpp draw the editor's fonts
+  // from a size-independent distance field atlas
+  const int TEXT_TECHNOLOGY_DISTANCEFIELD = 0x100;
+
   void StartTextRendering();
   void SetTextRenderingViewport( Scintilla::PRectangle rect );
   void EndTextRendering();
@@ -54,15 +100,54 @@ namespace Renderer
     int width;
     int height;
     TEXTURETYPE type;
+    bool distanceField; // alpha holds a signed distance (0.5 at the edge) instead of coverage
+  };
+
+  enum TEXTUREFORMAT // all of these are sRGB
+  {
+    TEXTUREFORMAT_RGBA8 = 0,
+    TEXTUREFORMAT_BC1, // 8 bytes per 4x4 block, no alpha
+    TEXTUREFORMAT_BC3, // 16 bytes per 4x4 block
+  };
+
+  struct MipLevel
+  {
+    int width;
+    int height;
+    const unsigned char * data; // tightly packed rows (of blocks, for the compressed formats)
+    size_t size;
   };
 
   Texture * CreateRGBA8TextureFromFile( const char * szFilename );
-  Texture * CreateA8TextureFromData( int w, int h, const unsigned char * data );
+  Texture * CreateTextureFromMipLevels( TEXTUREFORMAT format, const MipLevel * levels, int nLevels ); // levels[0] is the full size
+  Texture * CreateA8TextureFromData( int w, int h, const unsigned char * data, bool distanceField = false );
+  bool UpdateA8TextureRegion( Texture * tex, int x, int y, int w, int h, const unsigned char * data ); // data is w * h bytes
   Texture * Create1DR32Texture( int w );
   bool UpdateR32Texture( Texture * tex, float * data );
+  Texture * CreateRGBA32FTexture( int w, int h ); // point sampled and clamped; for data that shaders fetch texel by texel
+  bool UpdateRGBA32FTexture( Texture * tex, const float * data ); // w * h * 4 floats, top row first
   void SetShaderTexture( const char * szTextureName, Texture * tex );
+
+  // The texture variables that every shader may sample, as one table of names
+  // set when they're known (and again if they change); each shader resolves the
+  // table the first time it binds from it, so the per-frame binding goes by the
+  // index in the table instead of looking the name up in the shader every time.
+  void SetShaderTextureNames( const std::vector<std::string> & names );
+  void SetShaderTexture( int nName, Texture * tex );
   void BindTexture( Texture * tex ); // temporary function until all the quad rendering is moved to the renderer
   void ReleaseTexture( Texture * tex );
+
+  enum RENDERTARGETFORMAT
+  {
+    RENDERTARGETFORMAT_RGBA8 = 0,
+    RENDERTARGETFORMAT_RGBA16F,
+    RENDERTARGETFORMAT_RGBA32F,
+  };
+
+  // a texture that RenderFullscreenQuad() can draw into and shaders can then sample with SetShaderTexture()
+  Texture * CreateRenderTarget( int w, int h, RENDERTARGETFORMAT format = RENDERTARGETFORMAT_RGBA8 );
+  void SetRenderTarget( Texture * target ); // NULL is the back buffer; the viewport follows the target size
+
   struct Vertex
   {
     Vertex( float _x, float _y, unsigned int _c = 0xFFFFFFFF, float _u = 0.0, float _v = 0.0) : 
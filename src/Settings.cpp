@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "jsonxx.h"
+#include "Renderer.h"
+#include "FramePacing.h"
+#include "Compositor.h"
+#include "Settings.h"
+
+namespace Settings
+{
+  typedef enum
+  {
+    FIELD_BOOL,
+    FIELD_INT,
+    FIELD_FLOAT,
+    FIELD_DOUBLE,
+    FIELD_STRING,
+  } FIELDTYPE;
+
+  struct FIELD
+  {
+    const char * szSection; // NULL for the top level
+    const char * szKey;
+    FIELDTYPE type;
+    void * pValue;
+    double fDefault; // numbers and booleans
+    const char * szDefault; // strings
+    double fMin;
+    double fMax;
+    bool (*IsValid)( const char * szValue ); // strings, NULL if anything goes
+    bool bLive; // takes effect without a restart
+  };
+
+  bool IsValidFramePacing( const char * szValue )
+  {
+    RENDERER_FRAMEPACING mode;
+    return FramePacing::GetModeFromName( szValue, mode );
+  }
+
+  // the schema: every setting main.cpp reads, with its default and its limits
+  void GetFields( CONFIG & c, std::vector<FIELD> & fields )
+  {
+    const FIELD table[] =
+    {
+      { "window", "width", FIELD_INT, &c.window.nWidth, 1920, NULL, 16, 16384, NULL, false },
+      { "window", "height", FIELD_INT, &c.window.nHeight, 1080, NULL, 16, 16384, NULL, false },
+      { "window", "fullscreen", FIELD_BOOL, &c.window.bFullscreen, true, NULL, 0, 1, NULL, false },
+      { "rendering", "framePacing", FIELD_STRING, &c.rendering.sFramePacing, 0, "vsync", 0, 0, IsValidFramePacing, false },
+      { "rendering", "targetFrameRate", FIELD_FLOAT, &c.rendering.fTargetFrameRate, 60.0, NULL, 1, 1000, NULL, false },
+      { "rendering", "frameStatsInterval", FIELD_FLOAT, &c.rendering.fFrameStatsInterval, 0.0, NULL, 0, 3600, NULL, false },
+      { "rendering", "timeWrapPeriod", FIELD_DOUBLE, &c.rendering.fTimeWrapPeriod, 0.0, NULL, 0, 1e9, NULL, true },
+      { "rendering", "fftSmoothFactor", FIELD_FLOAT, &c.rendering.fFFTSmoothFactor, 0.9, NULL, 0, 1, NULL, true },
+      { "rendering", "textureMipmaps", FIELD_BOOL, &c.rendering.bTextureMipmaps, true, NULL, 0, 1, NULL, false },
+      { "rendering", "textureCompression", FIELD_BOOL, &c.rendering.bTextureCompression, false, NULL, 0, 1, NULL, false },
+      { "rendering", "textureCache", FIELD_STRING, &c.rendering.sTextureCache, 0, "", 0, 0, NULL, false },
+      { "font", "size", FIELD_INT, &c.font.nSize, 16, NULL, 4, 256, NULL, false },
+      { "font", "sdf", FIELD_BOOL, &c.font.bDistanceField, false, NULL, 0, 1, NULL, false },
+      { "font", "file", FIELD_STRING, &c.font.sFile, 0, "", 0, 0, NULL, false },
+      { "gui", "outputHeight", FIELD_INT, &c.gui.nOutputHeight, 200, NULL, 0, 16384, NULL, false },
+      { "gui", "texturePreviewWidth", FIELD_INT, &c.gui.nTexturePreviewWidth, 64, NULL, 0, 16384, NULL, false },
+      { "gui", "opacity", FIELD_INT, &c.gui.nOpacity, 0xC0, NULL, 0, 255, NULL, true },
+      { "gui", "spacesForTabs", FIELD_BOOL, &c.gui.bSpacesForTabs, true, NULL, 0, 1, NULL, false },
+      { "gui", "tabSize", FIELD_INT, &c.gui.nTabSize, 2, NULL, 1, 16, NULL, false },
+      { "gui", "visibleWhitespace", FIELD_BOOL, &c.gui.bVisibleWhitespace, false, NULL, 0, 1, NULL, false },
+      { "tabs", "count", FIELD_INT, &c.tabs.nCount, 1, NULL, 1, 9, NULL, false }, // Ctrl-1 .. Ctrl-9
+      { "tabs", "keepCompiled", FIELD_INT, &c.tabs.nKeepCompiled, 4, NULL, 1, 1000, NULL, true },
+      { "transition", "type", FIELD_STRING, &c.transition.sType, 0, "fade", 0, 0, Compositor::IsValidTransition, false },
+      { "transition", "duration", FIELD_DOUBLE, &c.transition.fDuration, 0.0, NULL, 0, 60, NULL, false },
+      { "transition", "outgoingScale", FIELD_FLOAT, &c.transition.fOutgoingScale, 0.5, NULL, 0.1, 1, NULL, false },
+      { "hotReload", "enabled", FIELD_BOOL, &c.hotReload.bEnabled, false, NULL, 0, 1, NULL, false },
+      { "hotReload", "debounce", FIELD_INT, &c.hotReload.nDebounce, 150, NULL, 0, 10000, NULL, false },
+      { NULL, "postExitCmd", FIELD_STRING, &c.sPostExitCmd, 0, "", 0, 0, NULL, true },
+    };
+    fields.assign( table, table + sizeof(table) / sizeof(table[0]) );
+  }
+
+  std::string GetPath( const FIELD & field )
+  {
+    return field.szSection ? std::string( field.szSection ) + "." + field.szKey : std::string( field.szKey );
+  }
+
+  void SetDefault( const FIELD & field )
+  {
+    switch (field.type)
+    {
+      case FIELD_BOOL: *(bool *)field.pValue = field.fDefault != 0.0; break;
+      case FIELD_INT: *(int *)field.pValue = (int)field.fDefault; break;
+      case FIELD_FLOAT: *(float *)field.pValue = (float)field.fDefault; break;
+      case FIELD_DOUBLE: *(double *)field.pValue = field.fDefault; break;
+      case FIELD_STRING: *(std::string *)field.pValue = field.szDefault; break;
+    }
+  }
+
+  bool IsEqual( const FIELD & a, const FIELD & b )
+  {
+    switch (a.type)
+    {
+      case FIELD_BOOL: return *(bool *)a.pValue == *(bool *)b.pValue;
+      case FIELD_INT: return *(int *)a.pValue == *(int *)b.pValue;
+      case FIELD_FLOAT: return *(float *)a.pValue == *(float *)b.pValue;
+      case FIELD_DOUBLE: return *(double *)a.pValue == *(double *)b.pValue;
+      case FIELD_STRING: return *(std::string *)a.pValue == *(std::string *)b.pValue;
+    }
+    return false;
+  }
+
+  void Copy( const FIELD & to, const FIELD & from )
+  {
+    switch (to.type)
+    {
+      case FIELD_BOOL: *(bool *)to.pValue = *(bool *)from.pValue; break;
+      case FIELD_INT: *(int *)to.pValue = *(int *)from.pValue; break;
+      case FIELD_FLOAT: *(float *)to.pValue = *(float *)from.pValue; break;
+      case FIELD_DOUBLE: *(double *)to.pValue = *(double *)from.pValue; break;
+      case FIELD_STRING: *(std::string *)to.pValue = *(std::string *)from.pValue; break;
+    }
+  }
+
+  void ParseField( const FIELD & field, jsonxx::Value * value )
+  {
+    std::string sPath = GetPath( field );
+    if (field.type == FIELD_BOOL)
+    {
+      if (!value->is<jsonxx::Boolean>())
+      {
+        printf("[Settings] %s should be true or false\n", sPath.c_str());
+        return;
+      }
+      *(bool *)field.pValue = value->get<jsonxx::Boolean>();
+    }
+    else if (field.type == FIELD_STRING)
+    {
+      if (!value->is<jsonxx::String>())
+      {
+        printf("[Settings] %s should be a string\n", sPath.c_str());
+        return;
+      }
+      const std::string & sValue = value->get<jsonxx::String>();
+      if (field.IsValid && !field.IsValid( sValue.c_str() ))
+      {
+        printf("[Settings] %s: \"%s\" isn't valid, using \"%s\"\n", sPath.c_str(), sValue.c_str(), field.szDefault);
+        return;
+      }
+      *(std::string *)field.pValue = sValue;
+    }
+    else
+    {
+      if (!value->is<jsonxx::Number>())
+      {
+        printf("[Settings] %s should be a number\n", sPath.c_str());
+        return;
+      }
+      double fValue = value->get<jsonxx::Number>();
+      if (fValue < field.fMin || fValue > field.fMax)
+      {
+        printf("[Settings] %s: %g is out of range (%g..%g), clamped\n", sPath.c_str(), fValue, field.fMin, field.fMax);
+        fValue = fValue < field.fMin ? field.fMin : field.fMax;
+      }
+      switch (field.type)
+      {
+        case FIELD_INT: *(int *)field.pValue = (int)fValue; break;
+        case FIELD_FLOAT: *(float *)field.pValue = (float)fValue; break;
+        default: *(double *)field.pValue = fValue; break;
+      }
+    }
+  }
+
+  void SetDefaults( CONFIG & config )
+  {
+    std::vector<FIELD> fields;
+    GetFields( config, fields );
+    for (int i = 0; i < fields.size(); i++)
+      SetDefault( fields[i] );
+    config.textures.clear();
+  }
+
+  // NULL if it's not there, or not an object
+  const jsonxx::Object * FindSection( const jsonxx::Object & o, const char * szSection )
+  {
+    std::map<std::string, jsonxx::Value*>::const_iterator it = o.kv_map().find( szSection );
+    return it != o.kv_map().end() && it->second->is<jsonxx::Object>() ? &it->second->get<jsonxx::Object>() : NULL;
+  }
+
+  void Parse( jsonxx::Object & o, CONFIG & config )
+  {
+    SetDefaults( config );
+
+    std::vector<FIELD> fields;
+    GetFields( config, fields );
+    for (int i = 0; i < fields.size(); i++)
+    {
+      const jsonxx::Object * section = fields[i].szSection ? FindSection( o, fields[i].szSection ) : &o;
+      if (!section)
+        continue;
+      std::map<std::string, jsonxx::Value*>::const_iterator it = section->kv_map().find( fields[i].szKey );
+      if (it != section->kv_map().end())
+        ParseField( fields[i], it->second );
+    }
+
+    // typos would otherwise silently fall back to the defaults
+    for (int i = 0; i < fields.size(); i++)
+    {
+      if (!fields[i].szSection || (i > 0 && fields[i - 1].szSection && !strcmp( fields[i - 1].szSection, fields[i].szSection )))
+        continue; // once per section; the schema keeps them together
+      if (!o.kv_map().count( fields[i].szSection ))
+        continue;
+
+      const jsonxx::Object * section = FindSection( o, fields[i].szSection );
+      if (!section)
+      {
+        printf("[Settings] %s should be an object\n", fields[i].szSection);
+        continue;
+      }
+      for (std::map<std::string, jsonxx::Value*>::const_iterator it = section->kv_map().begin(); it != section->kv_map().end(); it++)
+      {
+        bool bKnown = false;
+        for (int j = i; j < fields.size() && fields[j].szSection && !strcmp( fields[j].szSection, fields[i].szSection ) && !bKnown; j++)
+          bKnown = it->first == fields[j].szKey;
+        if (!bKnown)
+          printf("[Settings] %s.%s isn't a setting, ignored\n", fields[i].szSection, it->first.c_str());
+      }
+    }
+
+    const jsonxx::Object * textures = FindSection( o, "textures" );
+    if (textures)
+    {
+      const std::map<std::string, jsonxx::Value*> & kv = textures->kv_map();
+      for (std::map<std::string, jsonxx::Value*>::const_iterator it = kv.begin(); it != kv.end(); it++)
+      {
+        if (!it->second->is<jsonxx::String>())
+        {
+          printf("[Settings] textures.%s should be a file name\n", it->first.c_str());
+          continue;
+        }
+        TEXTURE texture;
+        texture.sName = it->first;
+        texture.sFilename = it->second->get<jsonxx::String>();
+        config.textures.push_back( texture );
+      }
+    }
+    else if (o.kv_map().count( "textures" ))
+    {
+      printf("[Settings] textures should be an object\n");
+    }
+  }
+
+  void ApplyChanges( CONFIG & config, const CONFIG & newConfig )
+  {
+    std::vector<FIELD> fields;
+    std::vector<FIELD> newFields;
+    GetFields( config, fields );
+    GetFields( (CONFIG &)newConfig, newFields );
+    for (int i = 0; i < fields.size(); i++)
+    {
+      if (IsEqual( fields[i], newFields[i] ))
+        continue;
+      if (fields[i].bLive)
+      {
+        Copy( fields[i], newFields[i] );
+        printf("[Settings] %s changed\n", GetPath( fields[i] ).c_str());
+      }
+      else
+      {
+        printf("[Settings] %s changed, restart to apply it\n", GetPath( fields[i] ).c_str());
+      }
+    }
+
+    bool bTexturesChanged = config.textures.size() != newConfig.textures.size();
+    for (int i = 0; i < config.textures.size() && !bTexturesChanged; i++)
+      bTexturesChanged = config.textures[i].sName != newConfig.textures[i].sName || config.textures[i].sFilename != newConfig.textures[i].sFilename;
+    if (bTexturesChanged)
+      printf("[Settings] textures changed, restart to apply them\n");
+  }
+}
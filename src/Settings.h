@@ -0,0 +1,78 @@
+#include <string>
+#include <vector>
+
+namespace Settings
+{
+  // The sections of config.json that main.cpp uses, parsed once into plain
+  // values. Every setting is described once in Settings.cpp with its type,
+  // default and range, and anything in these sections that doesn't fit is
+  // reported with its path (e.g. "gui.opacity") and replaced by the default.
+  // The sections owned by other modules (midi, osc, passes, the capture
+  // outputs, ...) are still parsed by those modules from the jsonxx object.
+  struct TEXTURE
+  {
+    std::string sName; // the shader variable
+    std::string sFilename;
+  };
+
+  struct CONFIG
+  {
+    struct
+    {
+      int nWidth;
+      int nHeight;
+      bool bFullscreen;
+    } window;
+    struct
+    {
+      std::string sFramePacing;
+      float fTargetFrameRate;
+      float fFrameStatsInterval;
+      double fTimeWrapPeriod;
+      float fFFTSmoothFactor;
+      bool bTextureMipmaps;
+      bool bTextureCompression;
+      std::string sTextureCache;
+    } rendering;
+    std::vector<TEXTURE> textures;
+    struct
+    {
+      int nSize;
+      bool bDistanceField;
+      std::string sFile; // empty for the platform default
+    } font;
+    struct
+    {
+      int nOutputHeight;
+      int nTexturePreviewWidth;
+      int nOpacity;
+      bool bSpacesForTabs;
+      int nTabSize;
+      bool bVisibleWhitespace;
+    } gui;
+    struct
+    {
+      int nCount;
+      int nKeepCompiled;
+    } tabs;
+    struct
+    {
+      std::string sType;
+      double fDuration;
+      float fOutgoingScale;
+    } transition;
+    struct
+    {
+      bool bEnabled;
+      int nDebounce;
+    } hotReload;
+    std::string sPostExitCmd;
+  };
+
+  void SetDefaults( CONFIG & config );
+  void Parse( jsonxx::Object & o, CONFIG & config ); // starts from the defaults
+
+  // for a config that changed while running: copies over the settings that can
+  // change on the fly, and reports the others as needing a restart
+  void ApplyChanges( CONFIG & config, const CONFIG & newConfig );
+}
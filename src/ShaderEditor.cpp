@@ -3,6 +3,10 @@
 #include "Renderer.h"
 #include "PropSetSimple.h"
 #include "Clipboard.h"
+#include "Timer.h"
+
+// lines styled per slice by DoIdleWork() once wrapping is done
+#define IDLE_STYLING_LINES 200
 
 ShaderEditor::ShaderEditor( Scintilla::Surface *s )
 {
@@ -12,6 +16,8 @@ ShaderEditor::ShaderEditor( Scintilla::Surface *s )
   nFontSize = 16;
   bHasMouseCapture = false;
   nOpacity = 0xC0;
+  bDistanceFieldFont = false;
+  bIdleWorkPending = false;
 }
 
 void ShaderEditor::SetAStyle(int style, Scintilla::ColourDesired fore, Scintilla::ColourDesired back, int size, const char *face)
@@ -89,6 +95,10 @@ void ShaderEditor::Initialise()
 
   WndProc( SCI_SETWRAPMODE, SC_WRAP_WORD, NULL );
 
+  // the technology ends up in the FontParameters of every font the styles create
+  if (bDistanceFieldFont)
+    technology = vs.technology = Renderer::TEXT_TECHNOLOGY_DISTANCEFIELD;
+
   //WndProc( SCI_SETLEXERLANGUAGE, SCLEX_CPP, NULL );
 
   SetAStyle( STYLE_DEFAULT,     0xFFFFFFFF, BACKGROUND( 0x000000 ), nFontSize, sFontFile.c_str() );
@@ -136,7 +146,7 @@ void ShaderEditor::Initialise()
   SetAStyle(SCE_C_COMMENT,      0xFF00FF00, BACKGROUND( 0x000000 ));
   SetAStyle(SCE_C_COMMENTLINE,  0xFF00FF00, BACKGROUND( 0x000000 ));
   
-  lexState->Colourise( 0, -1 );
+  // no Colourise(0,-1) here: painting styles what's visible, DoIdleWork() does the rest over the next frames
 
   //WndProc( SCI_COLOURISE, NULL, NULL );
 
@@ -151,6 +161,7 @@ void ShaderEditor::Initialise( SHADEREDITOR_OPTIONS &options )
   bUseSpacesForTabs = options.bUseSpacesForTabs;
   nTabSize = options.nTabSize;
   bVisibleWhitespace = options.bVisibleWhitespace;
+  bDistanceFieldFont = options.bDistanceFieldFont;
 
   Initialise();
   SetPosition( options.rect );
@@ -234,6 +245,16 @@ void ShaderEditor::Paint()
   Scintilla::Editor::Paint( surfaceWindow, GetClientRectangle() );
 }
 
+void ShaderEditor::SetOpacity( unsigned char nNewOpacity )
+{
+  nOpacity = nNewOpacity;
+  for (int i = 0; i < vs.styles.size(); i++) // only the ones in use
+    WndProc( SCI_STYLESETBACK, i, BACKGROUND( WndProc( SCI_STYLEGETBACK, i, NULL ) & 0xFFFFFF ) );
+  WndProc(SCI_SETFOLDMARGINCOLOUR,   1, BACKGROUND( 0x1A1A1A ));
+  WndProc(SCI_SETFOLDMARGINHICOLOUR, 1, BACKGROUND( 0x1A1A1A ));
+  WndProc(SCI_SETSELBACK,            1, BACKGROUND( 0xCC9966 ));
+}
+
 void ShaderEditor::SetText( const char * buf )
 {
   WndProc( SCI_SETREADONLY, false, NULL );
@@ -252,6 +273,34 @@ void ShaderEditor::Tick()
   Scintilla::Editor::Tick();
 }
 
+// Scintilla only wraps (and so styles) the visible lines in Paint() when
+// the platform supports idle work; without it every edit rewraps and
+// restyles the entire document below the caret in one go.
+bool ShaderEditor::SetIdle( bool on )
+{
+  if (on)
+    bIdleWorkPending = true;
+  return true;
+}
+
+void ShaderEditor::DoIdleWork( double fBudget )
+{
+  double fDeadline = Timer::GetTime() + fBudget;
+  while (Timer::GetTime() < fDeadline)
+  {
+    if (bIdleWorkPending)
+    {
+      bIdleWorkPending = Idle(); // wraps about a screen and a hundred lines per call
+      continue;
+    }
+
+    int endStyled = pdoc->GetEndStyled();
+    if (endStyled >= pdoc->Length())
+      break;
+    pdoc->EnsureStyledTo( pdoc->LineStart( pdoc->LineFromPosition( endStyled ) + IDLE_STYLING_LINES ) );
+  }
+}
+
 void ShaderEditor::SetTicking( bool on )
 {
 
@@ -267,18 +316,10 @@ void ShaderEditor::AddCharUTF( const char *s, unsigned int len, bool treatAsDBCS
   Scintilla::Editor::AddCharUTF( s, len, treatAsDBCS );
 }
 
-void ShaderEditor::GetText( char * buf, int len )
+const char * ShaderEditor::GetText()
 {
-  memset( buf, 0, len );
-
-  int lengthDoc = WndProc( SCI_GETLENGTH, NULL, NULL );
-
-  Scintilla::TextRange tr;
-  tr.chrg.cpMin = 0;
-  tr.chrg.cpMax = Scintilla::Platform::Minimum( len - 1, lengthDoc );
-  tr.lpstrText  = buf;
-
-  WndProc(SCI_GETTEXTRANGE, 0, reinterpret_cast<sptr_t>(&tr));
+  // closes the gap in Scintilla's buffer (a no-op if nothing was typed since) rather than copying it out
+  return (const char *)WndProc( SCI_GETCHARACTERPOINTER, NULL, NULL );
 }
 
 void ShaderEditor::NotifyStyleToNeeded(int endStyleNeeded) {
@@ -56,6 +56,7 @@ struct SHADEREDITOR_OPTIONS {
   bool bUseSpacesForTabs;
   int nTabSize;
   bool bVisibleWhitespace;
+  bool bDistanceFieldFont;
 };
 
 class ShaderEditor : public Scintilla::Editor
@@ -71,6 +72,8 @@ class ShaderEditor : public Scintilla::Editor
   bool bUseSpacesForTabs;
   int nTabSize;
   bool bVisibleWhitespace;
+  bool bDistanceFieldFont;
+  bool bIdleWorkPending;
 
 public:
   ShaderEditor(Scintilla::Surface *surfaceWindow);
@@ -99,11 +102,13 @@ public:
   void FineTickerCancel(TickReason);
 
   void SetText( const char * buf );
-  void GetText( char * buf, int len );
+  const char * GetText(); // the whole document, NUL terminated; only valid until it's edited
 
   void Paint();
   void SetAStyle(int style, Scintilla::ColourDesired fore, Scintilla::ColourDesired back=0xFFFFFFFF, int size=-1, const char *face=0);
   void Tick();
+  void DoIdleWork( double fBudget ); // ms; call every frame, wraps and styles the document in slices
+  bool SetIdle( bool on );
   int KeyDown(int key, bool shift, bool ctrl, bool alt, bool *consumed);
   void ButtonDown( Scintilla::Point pt, unsigned int curTime, bool shift, bool ctrl, bool alt );
   void ButtonMovePublic( Scintilla::Point pt );
@@ -112,5 +117,6 @@ public:
   void NotifyStyleToNeeded(int endStyleNeeded);
 
   void SetReadOnly( bool );
+  void SetOpacity( unsigned char nNewOpacity );
   Scintilla::Font * GetTextFont();
 };
@@ -0,0 +1,536 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include "Renderer.h"
+#include "Misc.h"
+#include "Timer.h"
+#include "TextureLoader.h"
+#include "stb_image.h"
+
+namespace TextureLoader
+{
+  // bump this when the processing changes, so stale cache entries are never picked up
+  const unsigned int nCacheVersion = 1;
+
+  float srgbToLinear[256];
+  unsigned char linearToSrgb[4096];
+  std::once_flag gammaTablesInitialized; // Load() runs on several threads at once during hot reloads
+
+  void InitGammaTables()
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      float c = i / 255.0f;
+      srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : powf( (c + 0.055f) / 1.055f, 2.4f );
+    }
+    for (int i = 0; i < 4096; i++)
+    {
+      float c = i / 4095.0f;
+      c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf( c, 1.0f / 2.4f ) - 0.055f;
+      linearToSrgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+    }
+  }
+
+  int GetBlockBytes( Renderer::TEXTUREFORMAT format )
+  {
+    return format == Renderer::TEXTUREFORMAT_BC1 ? 8 : 16;
+  }
+
+  size_t GetLevelSize( Renderer::TEXTUREFORMAT format, int w, int h )
+  {
+    if (format == Renderer::TEXTUREFORMAT_RGBA8)
+      return (size_t)w * h * 4;
+    return (size_t)((w + 3) / 4) * ((h + 3) / 4) * GetBlockBytes( format );
+  }
+
+  // levels only know their size until the data stops moving around
+  void SetLevelPointers( IMAGE & image )
+  {
+    size_t nOffset = 0;
+    for (int i = 0; i < image.levels.size(); i++)
+    {
+      image.levels[i].data = &image.data[nOffset];
+      nOffset += image.levels[i].size;
+    }
+  }
+
+  void AddLevel( IMAGE & image, int w, int h, const unsigned char * data )
+  {
+    Renderer::MipLevel level;
+    level.width = w;
+    level.height = h;
+    level.data = NULL;
+    level.size = GetLevelSize( image.format, w, h );
+    image.levels.push_back( level );
+    image.data.insert( image.data.end(), data, data + level.size );
+  }
+
+  //////////////////////////////////////////////////////////////////////////
+  // mipmaps, averaged in linear space so they don't get darker as they get smaller
+
+  void Downsample( const unsigned char * src, int w, int h, std::vector<unsigned char> & dst, int & nw, int & nh )
+  {
+    nw = w > 1 ? w / 2 : 1;
+    nh = h > 1 ? h / 2 : 1;
+    dst.resize( (size_t)nw * nh * 4 );
+    for (int y = 0; y < nh; y++)
+    {
+      const unsigned char * row0 = src + (size_t)(y * 2 < h ? y * 2 : h - 1) * w * 4;
+      const unsigned char * row1 = src + (size_t)(y * 2 + 1 < h ? y * 2 + 1 : h - 1) * w * 4;
+      for (int x = 0; x < nw; x++)
+      {
+        int x0 = (x * 2 < w ? x * 2 : w - 1) * 4;
+        int x1 = (x * 2 + 1 < w ? x * 2 + 1 : w - 1) * 4;
+        unsigned char * p = &dst[((size_t)y * nw + x) * 4];
+        for (int c = 0; c < 3; c++)
+        {
+          float f = (srgbToLinear[ row0[x0 + c] ] + srgbToLinear[ row0[x1 + c] ] + srgbToLinear[ row1[x0 + c] ] + srgbToLinear[ row1[x1 + c] ]) * 0.25f;
+          p[c] = linearToSrgb[ (int)(f * 4095.0f + 0.5f) ];
+        }
+        p[3] = (row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4;
+      }
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////
+  // BC1 / BC3 block compression: bounding box endpoints, nearest palette entry per pixel
+
+  unsigned short PackRGB565( const unsigned char * c )
+  {
+    return ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+  }
+
+  void UnpackRGB565( unsigned short v, int * c )
+  {
+    c[0] = ((v >> 11) & 31) * 255 / 31;
+    c[1] = ((v >> 5) & 63) * 255 / 63;
+    c[2] = (v & 31) * 255 / 31;
+  }
+
+  void CompressColorBlock( const unsigned char * block, unsigned char * out )
+  {
+    unsigned char lo[3] = { 255, 255, 255 };
+    unsigned char hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+      for (int c = 0; c < 3; c++)
+      {
+        if (block[i * 4 + c] < lo[c]) lo[c] = block[i * 4 + c];
+        if (block[i * 4 + c] > hi[c]) hi[c] = block[i * 4 + c];
+      }
+    }
+    // pull the endpoints in a bit; the extremes are usually outliers
+    for (int c = 0; c < 3; c++)
+    {
+      int inset = (hi[c] - lo[c]) >> 4;
+      lo[c] += inset;
+      hi[c] -= inset;
+    }
+
+    unsigned short c0 = PackRGB565( hi );
+    unsigned short c1 = PackRGB565( lo );
+    if (c0 < c1)
+    {
+      unsigned short t = c0; c0 = c1; c1 = t;
+    }
+
+    unsigned int indices = 0;
+    if (c0 != c1)
+    {
+      int palette[4][3];
+      UnpackRGB565( c0, palette[0] );
+      UnpackRGB565( c1, palette[1] );
+      for (int c = 0; c < 3; c++)
+      {
+        palette[2][c] = (palette[0][c] * 2 + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + palette[1][c] * 2) / 3;
+      }
+      for (int i = 0; i < 16; i++)
+      {
+        int nBest = 0;
+        int nBestDistance = 0x7FFFFFFF;
+        for (int j = 0; j < 4; j++)
+        {
+          int dr = block[i * 4 + 0] - palette[j][0];
+          int dg = block[i * 4 + 1] - palette[j][1];
+          int db = block[i * 4 + 2] - palette[j][2];
+          int nDistance = dr * dr + dg * dg + db * db;
+          if (nDistance < nBestDistance)
+          {
+            nBest = j;
+            nBestDistance = nDistance;
+          }
+        }
+        indices |= nBest << (i * 2);
+      }
+    }
+
+    out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+    out[4] = indices & 0xFF; out[5] = (indices >> 8) & 0xFF; out[6] = (indices >> 16) & 0xFF; out[7] = indices >> 24;
+  }
+
+  void CompressAlphaBlock( const unsigned char * block, unsigned char * out )
+  {
+    int a0 = 0;
+    int a1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+      if (block[i * 4 + 3] > a0) a0 = block[i * 4 + 3];
+      if (block[i * 4 + 3] < a1) a1 = block[i * 4 + 3];
+    }
+
+    unsigned long long indices = 0;
+    if (a0 != a1)
+    {
+      // a0 > a1 selects the 8 value mode: a0, a1, then 6 steps from a0 to a1
+      int palette[8] = { a0, a1 };
+      for (int j = 1; j < 7; j++)
+        palette[j + 1] = ((7 - j) * a0 + j * a1) / 7;
+      for (int i = 0; i < 16; i++)
+      {
+        int nBest = 0;
+        for (int j = 1; j < 8; j++)
+        {
+          if (abs( block[i * 4 + 3] - palette[j] ) < abs( block[i * 4 + 3] - palette[nBest] ))
+            nBest = j;
+        }
+        indices |= (unsigned long long)nBest << (i * 3);
+      }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (int i = 0; i < 6; i++)
+      out[2 + i] = (indices >> (i * 8)) & 0xFF;
+  }
+
+  void CompressLevel( Renderer::TEXTUREFORMAT format, const unsigned char * src, int w, int h, std::vector<unsigned char> & dst )
+  {
+    dst.resize( GetLevelSize( format, w, h ) );
+    unsigned char * out = &dst[0];
+    unsigned char block[64];
+    for (int by = 0; by < h; by += 4)
+    {
+      for (int bx = 0; bx < w; bx += 4)
+      {
+        // levels under 4 pixels still take a whole block; repeat the edge
+        for (int i = 0; i < 16; i++)
+        {
+          int x = bx + (i & 3) < w ? bx + (i & 3) : w - 1;
+          int y = by + (i >> 2) < h ? by + (i >> 2) : h - 1;
+          memcpy( block + i * 4, src + ((size_t)y * w + x) * 4, 4 );
+        }
+        if (format == Renderer::TEXTUREFORMAT_BC3)
+        {
+          CompressAlphaBlock( block, out );
+          out += 8;
+        }
+        CompressColorBlock( block, out );
+        out += 8;
+      }
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////
+  // DDS, both for the cache and for loading .dds files directly
+
+  struct DDS_PIXELFORMAT
+  {
+    unsigned int dwSize;
+    unsigned int dwFlags;
+    unsigned int dwFourCC;
+    unsigned int dwRGBBitCount;
+    unsigned int dwRBitMask;
+    unsigned int dwGBitMask;
+    unsigned int dwBBitMask;
+    unsigned int dwABitMask;
+  };
+
+  struct DDS_HEADER
+  {
+    unsigned int dwMagic;
+    unsigned int dwSize;
+    unsigned int dwFlags;
+    unsigned int dwHeight;
+    unsigned int dwWidth;
+    unsigned int dwPitchOrLinearSize;
+    unsigned int dwDepth;
+    unsigned int dwMipMapCount;
+    unsigned int dwReserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    unsigned int dwCaps;
+    unsigned int dwCaps2;
+    unsigned int dwCaps3;
+    unsigned int dwCaps4;
+    unsigned int dwReserved2;
+  };
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+#define DDS_FOURCC( a, b, c, d ) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+#define DDPF_ALPHAPIXELS 0x1
+#define DDPF_FOURCC 0x4
+#define DDPF_RGB 0x40
+
+  bool WriteDDS( const char * szFilename, const IMAGE & image )
+  {
+    DDS_HEADER header;
+    memset( &header, 0, sizeof(DDS_HEADER) );
+    header.dwMagic = DDS_MAGIC;
+    header.dwSize = sizeof(DDS_HEADER) - sizeof(header.dwMagic);
+    header.dwFlags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000; // caps, height, width, pixel format, mip count
+    header.dwFlags |= image.format == Renderer::TEXTUREFORMAT_RGBA8 ? 0x8 : 0x80000; // pitch / linear size
+    header.dwHeight = image.levels[0].height;
+    header.dwWidth = image.levels[0].width;
+    header.dwPitchOrLinearSize = image.format == Renderer::TEXTUREFORMAT_RGBA8 ? image.levels[0].width * 4 : (unsigned int)image.levels[0].size;
+    header.dwMipMapCount = (unsigned int)image.levels.size();
+    header.dwReserved1[0] = nCacheVersion;
+    header.ddspf.dwSize = sizeof(DDS_PIXELFORMAT);
+    switch (image.format)
+    {
+      case Renderer::TEXTUREFORMAT_RGBA8:
+        header.ddspf.dwFlags = DDPF_RGB | DDPF_ALPHAPIXELS;
+        header.ddspf.dwRGBBitCount = 32;
+        header.ddspf.dwRBitMask = 0x000000FF;
+        header.ddspf.dwGBitMask = 0x0000FF00;
+        header.ddspf.dwBBitMask = 0x00FF0000;
+        header.ddspf.dwABitMask = 0xFF000000;
+        break;
+      case Renderer::TEXTUREFORMAT_BC1:
+        header.ddspf.dwFlags = DDPF_FOURCC;
+        header.ddspf.dwFourCC = DDS_FOURCC( 'D', 'X', 'T', '1' );
+        break;
+      case Renderer::TEXTUREFORMAT_BC3:
+        header.ddspf.dwFlags = DDPF_FOURCC;
+        header.ddspf.dwFourCC = DDS_FOURCC( 'D', 'X', 'T', '5' );
+        break;
+    }
+    header.dwCaps = 0x1000 | (image.levels.size() > 1 ? 0x400000 | 0x8 : 0); // texture, mipmap, complex
+
+    FILE * f = fopen( szFilename, "wb" );
+    if (!f)
+      return false;
+    bool bSuccess = fwrite( &header, sizeof(DDS_HEADER), 1, f ) == 1 && fwrite( &image.data[0], image.data.size(), 1, f ) == 1;
+    fclose( f );
+    if (!bSuccess)
+      remove( szFilename );
+    return bSuccess;
+  }
+
+  bool ParseDDS( const char * szFilename, const unsigned char * pFile, size_t nFileSize, IMAGE & image )
+  {
+    const DDS_HEADER * header = (const DDS_HEADER *)pFile;
+    if (nFileSize < sizeof(DDS_HEADER) || header->dwMagic != DDS_MAGIC || header->dwSize != sizeof(DDS_HEADER) - sizeof(header->dwMagic))
+      return false;
+
+    bool bSwizzle = false;
+    if ((header->ddspf.dwFlags & DDPF_FOURCC) && header->ddspf.dwFourCC == DDS_FOURCC( 'D', 'X', 'T', '1' ))
+      image.format = Renderer::TEXTUREFORMAT_BC1;
+    else if ((header->ddspf.dwFlags & DDPF_FOURCC) && header->ddspf.dwFourCC == DDS_FOURCC( 'D', 'X', 'T', '5' ))
+      image.format = Renderer::TEXTUREFORMAT_BC3;
+    else if ((header->ddspf.dwFlags & DDPF_RGB) && header->ddspf.dwRGBBitCount == 32 && header->ddspf.dwGBitMask == 0x0000FF00 && (header->ddspf.dwRBitMask == 0x000000FF || header->ddspf.dwRBitMask == 0x00FF0000))
+    {
+      image.format = Renderer::TEXTUREFORMAT_RGBA8;
+      bSwizzle = header->ddspf.dwRBitMask == 0x00FF0000; // BGRA, what most tools write
+    }
+    else
+    {
+      printf("[TextureLoader] %s: only DXT1, DXT5 and 32 bit RGBA .dds files are supported\n", szFilename);
+      return false;
+    }
+
+    int nLevels = (header->dwFlags & 0x20000) && header->dwMipMapCount ? header->dwMipMapCount : 1;
+    int w = header->dwWidth;
+    int h = header->dwHeight;
+    const unsigned char * p = pFile + sizeof(DDS_HEADER);
+    for (int i = 0; i < nLevels; i++)
+    {
+      if (p + GetLevelSize( image.format, w, h ) > pFile + nFileSize)
+        return false;
+      AddLevel( image, w, h, p );
+      p += image.levels.back().size;
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+    }
+
+    if (bSwizzle)
+    {
+      for (size_t i = 0; i < image.data.size(); i += 4)
+      {
+        unsigned char t = image.data[i];
+        image.data[i] = image.data[i + 2];
+        image.data[i + 2] = t;
+      }
+    }
+    return true;
+  }
+
+  bool ReadDDS( const char * szFilename, IMAGE & image )
+  {
+    size_t nFileSize = 0;
+    const unsigned char * pFile = (const unsigned char *)Misc::MapFile( szFilename, nFileSize );
+    if (!pFile)
+      return false;
+
+    bool bSuccess = ParseDDS( szFilename, pFile, nFileSize, image );
+    Misc::UnmapFile( pFile, nFileSize );
+    if (!bSuccess)
+    {
+      image.data.clear();
+      image.levels.clear();
+    }
+    return bSuccess;
+  }
+
+  //////////////////////////////////////////////////////////////////////////
+
+  bool GetCacheFilename( const std::string & sFilename, const SETTINGS & settings, std::string & sCacheFilename )
+  {
+    unsigned long long nSize = 0;
+    unsigned long long nModified = 0;
+    if (!Misc::GetFileStamp( sFilename.c_str(), nSize, nModified ))
+      return false;
+
+    // FNV-1a over everything that changes the outcome
+    unsigned long long nHash = 14695981039346656037ULL;
+    unsigned long long values[] = { nSize, nModified, settings.bMipmaps, settings.bCompress, nCacheVersion };
+    for (int i = 0; i < sFilename.length(); i++)
+      nHash = (nHash ^ (unsigned char)sFilename[i]) * 1099511628211ULL;
+    for (int i = 0; i < sizeof(values); i++)
+      nHash = (nHash ^ ((unsigned char *)values)[i]) * 1099511628211ULL;
+
+    char szName[32];
+    sprintf( szName, "/%016llx.dds", nHash );
+    sCacheFilename = settings.sCacheDir + szName;
+    return true;
+  }
+
+  bool ProcessImage( IMAGE & image, const SETTINGS & settings )
+  {
+    int w = 0;
+    int h = 0;
+    int comp = 0;
+    unsigned char * c = stbi_load( image.sFilename.c_str(), &w, &h, &comp, STBI_rgb_alpha );
+    if (!c)
+    {
+      printf("[TextureLoader] Cannot load %s: %s\n", image.sFilename.c_str(), stbi_failure_reason());
+      return false;
+    }
+
+    image.format = Renderer::TEXTUREFORMAT_RGBA8;
+    if (settings.bCompress)
+    {
+      if (w % 4 == 0 && h % 4 == 0)
+      {
+        image.format = Renderer::TEXTUREFORMAT_BC1;
+        for (int i = 0; i < w * h; i++)
+        {
+          if (c[i * 4 + 3] != 255)
+          {
+            image.format = Renderer::TEXTUREFORMAT_BC3;
+            break;
+          }
+        }
+      }
+      else
+      {
+        printf("[TextureLoader] %s is %d x %d, not a multiple of 4, so it stays uncompressed\n", image.sFilename.c_str(), w, h);
+      }
+    }
+
+    std::vector<unsigned char> level( c, c + (size_t)w * h * 4 );
+    stbi_image_free( c );
+
+    std::vector<unsigned char> next;
+    std::vector<unsigned char> compressed;
+    while (true)
+    {
+      if (image.format == Renderer::TEXTUREFORMAT_RGBA8)
+      {
+        AddLevel( image, w, h, &level[0] );
+      }
+      else
+      {
+        CompressLevel( image.format, &level[0], w, h, compressed );
+        AddLevel( image, w, h, &compressed[0] );
+      }
+
+      if (!settings.bMipmaps || (w == 1 && h == 1))
+        break;
+      Downsample( &level[0], w, h, next, w, h );
+      level.swap( next );
+    }
+    return true;
+  }
+
+  void LoadFile( IMAGE & image, const SETTINGS & settings, std::atomic<int> & nCacheHits )
+  {
+    std::string sCacheFilename;
+    bool bCache = !settings.sCacheDir.empty() && GetCacheFilename( image.sFilename, settings, sCacheFilename );
+    if (bCache && Misc::FileExists( sCacheFilename.c_str() ) && ReadDDS( sCacheFilename.c_str(), image ))
+    {
+      nCacheHits++;
+    }
+    else
+    {
+      size_t nLength = image.sFilename.length();
+      bool bDDS = nLength > 4 && (image.sFilename.compare( nLength - 4, 4, ".dds" ) == 0 || image.sFilename.compare( nLength - 4, 4, ".DDS" ) == 0);
+      if (bDDS)
+      {
+        image.bValid = ReadDDS( image.sFilename.c_str(), image ); // used as is, not worth caching
+        if (!image.bValid)
+          printf("[TextureLoader] Cannot load %s\n", image.sFilename.c_str());
+        else
+          SetLevelPointers( image );
+        return;
+      }
+      if (!ProcessImage( image, settings ))
+        return;
+      if (bCache && !WriteDDS( sCacheFilename.c_str(), image ))
+        printf("[TextureLoader] Cannot write %s to the cache\n", sCacheFilename.c_str());
+    }
+    SetLevelPointers( image );
+    image.bValid = true;
+  }
+
+  void Load( std::vector<IMAGE> & images, const SETTINGS & settings )
+  {
+    if (images.empty())
+      return;
+
+    double fStart = Timer::GetTime();
+    std::call_once( gammaTablesInitialized, InitGammaTables );
+    if (!settings.sCacheDir.empty() && !Misc::MakeDirectory( settings.sCacheDir.c_str() ))
+      printf("[TextureLoader] Cannot create cache directory %s\n", settings.sCacheDir.c_str());
+
+    for (int i = 0; i < images.size(); i++)
+    {
+      images[i].bValid = false;
+      images[i].data.clear();
+      images[i].levels.clear();
+    }
+
+    std::atomic<int> nNext( 0 );
+    std::atomic<int> nCacheHits( 0 );
+    auto Worker = [&]()
+    {
+      for (int i = nNext++; i < images.size(); i = nNext++)
+        LoadFile( images[i], settings, nCacheHits );
+    };
+
+    int nThreads = std::thread::hardware_concurrency();
+    nThreads = nThreads < 1 ? 1 : nThreads > images.size() ? (int)images.size() : nThreads;
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++)
+      threads.push_back( std::thread( Worker ) );
+    Worker();
+    for (int i = 0; i < threads.size(); i++)
+      threads[i].join();
+
+    printf("[TextureLoader] %d images in %.0f ms on %d threads, %d from the cache\n", (int)images.size(), Timer::GetTime() - fStart, nThreads, (int)nCacheHits);
+  }
+}
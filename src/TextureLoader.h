@@ -0,0 +1,25 @@
+#include <string>
+#include <vector>
+
+namespace TextureLoader
+{
+  struct SETTINGS
+  {
+    bool bMipmaps;
+    bool bCompress; // BC1, or BC3 for images with alpha; needs width and height to be multiples of 4
+    std::string sCacheDir; // processed images are kept here as .dds, empty to disable
+  };
+
+  struct IMAGE
+  {
+    std::string sFilename;
+    bool bValid;
+    Renderer::TEXTUREFORMAT format;
+    std::vector<unsigned char> data;
+    std::vector<Renderer::MipLevel> levels; // pointing into data
+  };
+
+  // Decodes (or fetches from the cache) all images on worker threads; only the
+  // upload, with Renderer::CreateTextureFromMipLevels(), is left to the caller.
+  void Load( std::vector<IMAGE> & images, const SETTINGS & settings );
+}
@@ -1,5 +1,6 @@
 namespace Timer
 {
   void Start();
-  float GetTime();
+  double GetTime(); // milliseconds since Start()
+  unsigned long long GetTimeNS(); // nanoseconds since Start(), monotonic; use this for anything long-running
 }
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "jsonxx.h"
+#include "Renderer.h"
+#include "Capture.h"
+
+namespace Capture
+{
+  struct SinkFactory
+  {
+    std::string sName;
+    SINK_FACTORY factory;
+  };
+
+  struct SinkInstance
+  {
+    std::string sName;
+    Sink * pSink;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    Frame * pPendingFrame;
+    bool bQuit;
+    unsigned int nDroppedFrames;
+  };
+
+  std::vector<SinkFactory> factories;
+  std::vector<SinkInstance*> sinks;
+  int nFramePoolDepth = 0;
+  bool bFramePoolHugePages = false;
+
+  void RegisterSink( const char * szName, SINK_FACTORY factory )
+  {
+    SinkFactory f;
+    f.sName = szName;
+    f.factory = factory;
+    factories.push_back( f );
+  }
+
+  void RegisterBuiltinSinks()
+  {
+    if (factories.size())
+      return;
+#ifdef BONZOMATIC_ENABLE_NDI
+    RegisterSink( "ndi", CreateNDISink );
+#endif
+    RegisterSink( "rawVideo", CreateRawVideoSink );
+#ifdef __linux__
+    RegisterSink( "sharedMemory", CreateSharedMemorySink );
+#endif
+  }
+
+  void SinkThreadProc( SinkInstance * instance )
+  {
+    while (true)
+    {
+      Frame * frame = NULL;
+      {
+        std::unique_lock<std::mutex> lock( instance->mutex );
+        while (!instance->pPendingFrame && !instance->bQuit)
+          instance->cond.wait( lock );
+        if (!instance->pPendingFrame)
+          break;
+        frame = instance->pPendingFrame;
+        instance->pPendingFrame = NULL;
+      }
+      instance->pSink->SendFrame( frame );
+      ReleaseFrame( frame );
+    }
+  }
+
+  void LoadSettings(jsonxx::Object & o)
+  {
+    RegisterBuiltinSinks();
+
+    if (o.has<jsonxx::Object>("capture"))
+    {
+      if (o.get<jsonxx::Object>("capture").has<jsonxx::Number>("bufferCount"))
+        nFramePoolDepth = o.get<jsonxx::Object>("capture").get<jsonxx::Number>("bufferCount");
+      if (o.get<jsonxx::Object>("capture").has<jsonxx::Boolean>("hugePages"))
+        bFramePoolHugePages = o.get<jsonxx::Object>("capture").get<jsonxx::Boolean>("hugePages");
+    }
+
+    for (int i = 0; i < factories.size(); i++)
+    {
+      Sink * sink = factories[i].factory();
+      if (!sink->LoadSettings( o ))
+      {
+        delete sink;
+        continue;
+      }
+      SinkInstance * instance = new SinkInstance();
+      instance->sName = factories[i].sName;
+      instance->pSink = sink;
+      instance->pPendingFrame = NULL;
+      instance->bQuit = false;
+      instance->nDroppedFrames = 0;
+      sinks.push_back( instance );
+    }
+  }
+
+  // undoes a partly done Open(): the first nOpened sinks are open, no threads run yet
+  void CloseAfterFailedOpen( int nOpened )
+  {
+    for (int i = 0; i < sinks.size(); i++)
+    {
+      if (i < nOpened)
+        sinks[i]->pSink->Close();
+      delete sinks[i]->pSink;
+      delete sinks[i];
+    }
+    sinks.clear();
+
+    CloseFramePool();
+  }
+
+  bool Open(RENDERER_SETTINGS & settings)
+  {
+    if (!sinks.size())
+      return true;
+
+    for (int i = 0; i < sinks.size(); i++)
+    {
+      if (!sinks[i]->pSink->Open( settings ))
+      {
+        printf("[Capture] Cannot open sink \"%s\"\n", sinks[i]->sName.c_str());
+        CloseAfterFailedOpen( i );
+        return false;
+      }
+      printf("[Capture] Sink \"%s\" opened\n", sinks[i]->sName.c_str());
+    }
+
+    // one frame being grabbed, plus one in flight and one pending per sink, and whatever the sinks hold on to
+    if (nFramePoolDepth <= 0)
+    {
+      nFramePoolDepth = 1;
+      for (int i = 0; i < sinks.size(); i++)
+        nFramePoolDepth += 2 + sinks[i]->pSink->GetHeldFrameCount();
+    }
+    if (!OpenFramePool( settings.nWidth, settings.nHeight, nFramePoolDepth, bFramePoolHugePages ))
+    {
+      CloseAfterFailedOpen( sinks.size() );
+      return false;
+    }
+
+    for (int i = 0; i < sinks.size(); i++)
+    {
+      sinks[i]->thread = std::thread( SinkThreadProc, sinks[i] );
+    }
+    return true;
+  }
+
+  void CaptureFrame()
+  {
+    if (!sinks.size())
+      return;
+
+    Frame * frame = AcquireFrame();
+    if (!frame)
+      return;
+
+    if (!Renderer::GrabFrame( frame->pData ))
+    {
+      ReleaseFrame( frame );
+      return;
+    }
+
+    frame->nRefCount = sinks.size();
+    for (int i = 0; i < sinks.size(); i++)
+    {
+      SinkInstance * instance = sinks[i];
+      std::lock_guard<std::mutex> lock( instance->mutex );
+      if (instance->pPendingFrame)
+      {
+        // the sink is still busy with an older frame; replace what it hasn't picked up yet
+        ReleaseFrame( instance->pPendingFrame );
+        instance->nDroppedFrames++;
+      }
+      instance->pPendingFrame = frame;
+      instance->cond.notify_one();
+    }
+  }
+
+  void Close()
+  {
+    for (int i = 0; i < sinks.size(); i++)
+    {
+      SinkInstance * instance = sinks[i];
+      if (instance->thread.joinable())
+      {
+        {
+          std::lock_guard<std::mutex> lock( instance->mutex );
+          instance->bQuit = true;
+          instance->cond.notify_one();
+        }
+        instance->thread.join();
+      }
+      if (instance->nDroppedFrames)
+        printf("[Capture] Sink \"%s\" dropped %u frames\n", instance->sName.c_str(), instance->nDroppedFrames);
+      instance->pSink->Close();
+      delete instance->pSink;
+      delete instance;
+    }
+    sinks.clear();
+
+    CloseFramePool();
+  }
+}
@@ -1,19 +0,0 @@
-#include "jsonxx.h"
-#include "Renderer.h"
-
-namespace Capture
-{
-  void LoadSettings(jsonxx::Object & o)
-  {
-  }
-  bool Open(RENDERER_SETTINGS & settings)
-  {
-    return true;
-  }
-  void CaptureFrame()
-  {
-  }
-  void Close()
-  {
-  }
-}
\ No newline at end of file
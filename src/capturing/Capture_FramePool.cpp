@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <vector>
+#include <atomic>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "jsonxx.h"
+#include "Renderer.h"
+#include "Capture.h"
+
+namespace Capture
+{
+  std::vector<Frame*> pool;
+  int nPoolWidth = 0;
+  int nPoolHeight = 0;
+  bool bPoolHugePages = false;
+  std::atomic<bool> bPoolHugeTLBFailed( false ); // no reserved huge pages; later buffers only ask for transparent ones
+  std::atomic<unsigned int> nPoolExhaustedCount( 0 ); // the render and NDI threads both acquire
+
+  size_t GetPageSize( bool bHuge )
+  {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    return info.dwAllocationGranularity;
+#else
+    return bHuge ? 2 * 1024 * 1024 : sysconf(_SC_PAGESIZE);
+#endif
+  }
+
+  unsigned char * AllocateFrameBuffer( size_t & nSize )
+  {
+    size_t nPageSize = GetPageSize( bPoolHugePages );
+    nSize = (nSize + nPageSize - 1) & ~(nPageSize - 1);
+#ifdef _WIN32
+    return (unsigned char *)VirtualAlloc( NULL, nSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+#else
+    void * p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (bPoolHugePages && !bPoolHugeTLBFailed)
+    {
+      p = mmap( NULL, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+      if (p == MAP_FAILED)
+      {
+        printf("[Capture] No huge pages reserved for capture buffers, asking for transparent huge pages instead\n");
+        bPoolHugeTLBFailed = true;
+      }
+    }
+#endif
+    if (p == MAP_FAILED)
+    {
+      p = mmap( NULL, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+#ifdef MADV_HUGEPAGE
+      if (p != MAP_FAILED && bPoolHugePages)
+        madvise( p, nSize, MADV_HUGEPAGE );
+#endif
+    }
+    return p == MAP_FAILED ? NULL : (unsigned char *)p;
+#endif
+  }
+
+  void FreeFrameBuffer( unsigned char * p, size_t nSize )
+  {
+    if (!p)
+      return;
+#ifdef _WIN32
+    VirtualFree( p, 0, MEM_RELEASE );
+#else
+    munmap( p, nSize );
+#endif
+  }
+
+  bool OpenFramePool( int nWidth, int nHeight, int nDepth, bool bHugePages )
+  {
+    bPoolHugePages = bHugePages;
+    bPoolHugeTLBFailed = false;
+    SetFramePoolSize( nWidth, nHeight );
+    for (int i = 0; i < nDepth; i++)
+    {
+      Frame * frame = new Frame();
+      frame->nWidth = nWidth;
+      frame->nHeight = nHeight;
+      frame->nCapacity = nWidth * nHeight * 4;
+      frame->pData = AllocateFrameBuffer( frame->nCapacity );
+      frame->nRefCount = 0;
+      if (!frame->pData)
+      {
+        printf("[Capture] Cannot allocate capture buffer %d of %d\n", i + 1, nDepth);
+        delete frame;
+        return false;
+      }
+      pool.push_back( frame );
+    }
+    return true;
+  }
+
+  void SetFramePoolSize( int nWidth, int nHeight )
+  {
+    nPoolWidth = nWidth;
+    nPoolHeight = nHeight;
+  }
+
+  Frame * AcquireFrame()
+  {
+    for (int i = 0; i < pool.size(); i++)
+    {
+      int nExpected = 0;
+      if (!pool[i]->nRefCount.compare_exchange_strong( nExpected, 1 ))
+        continue;
+
+      Frame * frame = pool[i];
+      size_t nSize = nPoolWidth * nPoolHeight * 4;
+      if (frame->nCapacity < nSize)
+      {
+        // resolution went up since this buffer was made; smaller sizes just reuse it
+        FreeFrameBuffer( frame->pData, frame->nCapacity );
+        frame->nCapacity = nSize;
+        frame->pData = AllocateFrameBuffer( frame->nCapacity );
+        if (!frame->pData)
+        {
+          frame->nCapacity = 0;
+          frame->nRefCount = 0;
+          return NULL;
+        }
+      }
+      frame->nWidth = nPoolWidth;
+      frame->nHeight = nPoolHeight;
+      return frame;
+    }
+
+    if (!nPoolExhaustedCount++)
+      printf("[Capture] All %d capture buffers are in use, dropping frames (raise \"capture\":{\"bufferCount\"} if this keeps happening)\n", (int)pool.size());
+    return NULL;
+  }
+
+  void ReleaseFrame( Frame * frame )
+  {
+    frame->nRefCount--;
+  }
+
+  void CloseFramePool()
+  {
+    if (nPoolExhaustedCount)
+      printf("[Capture] Capture buffer pool was exhausted %u times\n", nPoolExhaustedCount.load());
+    nPoolExhaustedCount = 0;
+
+    for (int i = 0; i < pool.size(); i++)
+    {
+      FreeFrameBuffer( pool[i]->pData, pool[i]->nCapacity );
+      delete pool[i];
+    }
+    pool.clear();
+  }
+}
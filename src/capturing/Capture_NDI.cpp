@@ -3,38 +3,50 @@
 #include <string>
 #include "jsonxx.h"
 #include "Renderer.h"
+#include "Capture.h"
 
 namespace Capture
 {
-  std::string sNDIConnectionString;
-  float fNDIFrameRate = 60.0;
-  std::string sNDIIdentifier;
-  bool bNDIProgressive = true;
-  bool bNDIEnabled = true;
-  unsigned int * pBuffer[2] = { NULL, NULL };
-  unsigned int nBufferIndex = 0;
-  NDIlib_video_frame_v2_t pNDIFrame;
-  NDIlib_send_instance_t pNDI_send;
-
-  void LoadSettings(jsonxx::Object & o)
+  class NDISink : public Sink
   {
-    if (o.has<jsonxx::Object>("ndi"))
+    std::string sNDIConnectionString;
+    float fNDIFrameRate;
+    std::string sNDIIdentifier;
+    bool bNDIProgressive;
+    bool bNDIEnabled;
+    Frame * pSentFrame;
+    NDIlib_video_frame_v2_t pNDIFrame;
+    NDIlib_send_instance_t pNDI_send;
+
+  public:
+    NDISink()
     {
-      if (o.get<jsonxx::Object>("ndi").has<jsonxx::Boolean>("enabled"))
-        bNDIEnabled = o.get<jsonxx::Object>("ndi").get<jsonxx::Boolean>("enabled");
-      if (o.get<jsonxx::Object>("ndi").has<jsonxx::String>("connectionString"))
-        sNDIConnectionString = o.get<jsonxx::Object>("ndi").get<jsonxx::String>("connectionString");
-      if (o.get<jsonxx::Object>("ndi").has<jsonxx::String>("identifier"))
-        sNDIIdentifier = o.get<jsonxx::Object>("ndi").get<jsonxx::String>("identifier");
-      if (o.get<jsonxx::Object>("ndi").has<jsonxx::Number>("frameRate"))
-        fNDIFrameRate = (float)o.get<jsonxx::Object>("ndi").get<jsonxx::Number>("frameRate");
-      if (o.get<jsonxx::Object>("ndi").has<jsonxx::Boolean>("progressive"))
-        bNDIProgressive = o.get<jsonxx::Object>("ndi").get<jsonxx::Boolean>("progressive");
+      fNDIFrameRate = 60.0;
+      bNDIProgressive = true;
+      bNDIEnabled = true;
+      pSentFrame = NULL;
+      pNDI_send = NULL;
     }
-  }
-  bool Open(RENDERER_SETTINGS & settings)
-  {
-    if (bNDIEnabled)
+
+    bool LoadSettings(jsonxx::Object & o)
+    {
+      if (o.has<jsonxx::Object>("ndi"))
+      {
+        if (o.get<jsonxx::Object>("ndi").has<jsonxx::Boolean>("enabled"))
+          bNDIEnabled = o.get<jsonxx::Object>("ndi").get<jsonxx::Boolean>("enabled");
+        if (o.get<jsonxx::Object>("ndi").has<jsonxx::String>("connectionString"))
+          sNDIConnectionString = o.get<jsonxx::Object>("ndi").get<jsonxx::String>("connectionString");
+        if (o.get<jsonxx::Object>("ndi").has<jsonxx::String>("identifier"))
+          sNDIIdentifier = o.get<jsonxx::Object>("ndi").get<jsonxx::String>("identifier");
+        if (o.get<jsonxx::Object>("ndi").has<jsonxx::Number>("frameRate"))
+          fNDIFrameRate = (float)o.get<jsonxx::Object>("ndi").get<jsonxx::Number>("frameRate");
+        if (o.get<jsonxx::Object>("ndi").has<jsonxx::Boolean>("progressive"))
+          bNDIProgressive = o.get<jsonxx::Object>("ndi").get<jsonxx::Boolean>("progressive");
+      }
+      return bNDIEnabled;
+    }
+
+    bool Open(RENDERER_SETTINGS & settings)
     {
       if (!NDIlib_initialize())
       {
@@ -71,38 +83,52 @@ namespace Capture
       pNDIFrame.picture_aspect_ratio = settings.nWidth / (float)settings.nHeight;
       pNDIFrame.frame_format_type = bNDIProgressive ? NDIlib_frame_format_type_progressive : NDIlib_frame_format_type_interleaved;
       pNDIFrame.timecode = NDIlib_send_timecode_synthesize;
-      pBuffer[0] = new unsigned int[settings.nWidth * settings.nHeight * 4];
-      pBuffer[1] = new unsigned int[settings.nWidth * settings.nHeight * 4];
       pNDIFrame.p_data = NULL;
       pNDIFrame.line_stride_in_bytes = settings.nWidth * 4;
+      return true;
     }
-    return true;
-  }
-  void CaptureFrame()
-  {
-    if (pBuffer[0] && pBuffer[1])
+
+    void SendFrame( const Frame * frame )
     {
-      pNDIFrame.p_data = (unsigned char*)pBuffer[ nBufferIndex ];
-      nBufferIndex = (nBufferIndex + 1) & 1;
-      if (Renderer::GrabFrame( pNDIFrame.p_data ))
-      {
-        unsigned int * p = (unsigned int *)pNDIFrame.p_data;
-        for(int i=0; i < pNDIFrame.xres * pNDIFrame.yres; i++)
-          p[i] = (p[i] & 0x00FF00) | ((p[i] >> 16) & 0xFF) | ((p[i] & 0xFF) << 16) | 0xFF000000;
-        NDIlib_send_send_video_async_v2(pNDI_send, &pNDIFrame);
-      }
+      Frame * converted = AcquireFrame();
+      if (!converted)
+        return;
+
+      const unsigned int * src = (const unsigned int *)frame->pData;
+      unsigned int * p = (unsigned int *)converted->pData;
+      for(int i=0; i < pNDIFrame.xres * pNDIFrame.yres; i++)
+        p[i] = (src[i] & 0x00FF00) | ((src[i] >> 16) & 0xFF) | ((src[i] & 0xFF) << 16) | 0xFF000000;
+      pNDIFrame.p_data = converted->pData;
+      NDIlib_send_send_video_async_v2(pNDI_send, &pNDIFrame);
+
+      // the async send keeps reading the previous buffer until this call, so only now can it go back to the pool
+      if (pSentFrame)
+        ReleaseFrame( pSentFrame );
+      pSentFrame = converted;
     }
-  }
-  void Close()
-  {
-    if (pBuffer[0] && pBuffer[1])
+
+    // the frame the async send is still reading, plus the one being converted next to it
+    int GetHeldFrameCount()
     {
-      NDIlib_send_send_video_async_v2(pNDI_send, NULL); // stop async thread
+      return 2;
+    }
 
-      delete[] pBuffer[0];
-      delete[] pBuffer[1];
-      NDIlib_send_destroy(pNDI_send);
-      NDIlib_destroy();
+    void Close()
+    {
+      if (pNDI_send)
+      {
+        NDIlib_send_send_video_async_v2(pNDI_send, NULL); // stop async thread
+
+        if (pSentFrame)
+          ReleaseFrame( pSentFrame );
+        NDIlib_send_destroy(pNDI_send);
+        NDIlib_destroy();
+      }
     }
+  };
+
+  Sink * CreateNDISink()
+  {
+    return new NDISink();
   }
-}
\ No newline at end of file
+}
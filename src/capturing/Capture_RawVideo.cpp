@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#ifndef _WIN32
+#include <signal.h>
+#endif
+#include "jsonxx.h"
+#include "Renderer.h"
+#include "Capture.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define POPEN_WRITE_MODE "wb"
+#else
+#define POPEN_WRITE_MODE "w"
+#endif
+
+namespace Capture
+{
+  // Writes every frame as raw RGBA bytes into a file, a named pipe, or
+  // the stdin of a command (e.g. ffmpeg -f rawvideo -pix_fmt rgba ...).
+  class RawVideoSink : public Sink
+  {
+    std::string sFilename;
+    std::string sCommand;
+    FILE * pFile;
+    bool bIsPipe;
+    bool bFailed;
+
+    void ReplaceToken( std::string & s, const char * szToken, int nValue )
+    {
+      char sz[16];
+      snprintf( sz, 16, "%d", nValue );
+      while (s.find(szToken) != std::string::npos)
+        s.replace( s.find(szToken), strlen(szToken), sz );
+    }
+
+  public:
+    RawVideoSink()
+    {
+      pFile = NULL;
+      bIsPipe = false;
+      bFailed = false;
+    }
+
+    bool LoadSettings(jsonxx::Object & o)
+    {
+      if (!o.has<jsonxx::Object>("rawVideo"))
+        return false;
+
+      jsonxx::Object & raw = o.get<jsonxx::Object>("rawVideo");
+      if (raw.has<jsonxx::Boolean>("enabled") && !raw.get<jsonxx::Boolean>("enabled"))
+        return false;
+      if (raw.has<jsonxx::String>("file"))
+        sFilename = raw.get<jsonxx::String>("file");
+      if (raw.has<jsonxx::String>("command"))
+        sCommand = raw.get<jsonxx::String>("command");
+      return sFilename.length() || sCommand.length();
+    }
+
+    bool Open(RENDERER_SETTINGS & settings)
+    {
+#ifndef _WIN32
+      // a reader going away should end the capture, not the whole program
+      signal( SIGPIPE, SIG_IGN );
+#endif
+      printf("[Capture] Raw video: %d x %d, 4 bytes per pixel (RGBA), top row first\n", settings.nWidth, settings.nHeight);
+      if (sCommand.length())
+      {
+        ReplaceToken( sCommand, "{%width%}", settings.nWidth );
+        ReplaceToken( sCommand, "{%height%}", settings.nHeight );
+        pFile = popen( sCommand.c_str(), POPEN_WRITE_MODE );
+        if (!pFile)
+        {
+          printf("[Capture] Cannot start \"%s\"\n", sCommand.c_str());
+          return false;
+        }
+        bIsPipe = true;
+      }
+      // files are opened on the first frame instead, since opening a FIFO blocks until there's a reader
+      return true;
+    }
+
+    void SendFrame( const Frame * frame )
+    {
+      if (bFailed)
+        return;
+
+      if (!pFile)
+      {
+        pFile = fopen( sFilename.c_str(), "wb" );
+        if (!pFile)
+        {
+          printf("[Capture] Cannot open \"%s\" for writing\n", sFilename.c_str());
+          bFailed = true;
+          return;
+        }
+      }
+
+      size_t nSize = frame->nWidth * frame->nHeight * 4;
+      if (fwrite( frame->pData, 1, nSize, pFile ) != nSize)
+      {
+        printf("[Capture] Raw video write failed, stopping\n");
+        bFailed = true;
+      }
+    }
+
+    void Close()
+    {
+      if (pFile)
+      {
+        if (bIsPipe)
+          pclose( pFile );
+        else
+          fclose( pFile );
+        pFile = NULL;
+      }
+    }
+  };
+
+  Sink * CreateRawVideoSink()
+  {
+    return new RawVideoSink();
+  }
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "jsonxx.h"
+#include "Renderer.h"
+#include "Capture.h"
+#include "Capture_SharedMemory.h"
+
+namespace Capture
+{
+  // Publishes frames into a POSIX shared memory ring (see Capture_SharedMemory.h)
+  // so local compositors can map them without going through the network.
+  class SharedMemorySink : public Sink
+  {
+    std::string sName;
+    int nSlotCount;
+    int hSharedMemory;
+    size_t nMappingSize;
+    unsigned char * pMapping;
+    SHAREDMEMORY_HEADER * pHeader;
+    uint64_t nFrameIndex;
+
+  public:
+    SharedMemorySink()
+    {
+      sName = "/bonzomatic";
+      nSlotCount = 3;
+      hSharedMemory = -1;
+      nMappingSize = 0;
+      pMapping = NULL;
+      pHeader = NULL;
+      nFrameIndex = 0;
+    }
+
+    bool LoadSettings(jsonxx::Object & o)
+    {
+      if (!o.has<jsonxx::Object>("sharedMemory"))
+        return false;
+
+      jsonxx::Object & shm = o.get<jsonxx::Object>("sharedMemory");
+      if (shm.has<jsonxx::Boolean>("enabled") && !shm.get<jsonxx::Boolean>("enabled"))
+        return false;
+      if (shm.has<jsonxx::String>("name"))
+        sName = shm.get<jsonxx::String>("name");
+      if (shm.has<jsonxx::Number>("slots"))
+        nSlotCount = shm.get<jsonxx::Number>("slots");
+      if (nSlotCount < 2)
+        nSlotCount = 2;
+      if (nSlotCount > SHAREDMEMORY_MAX_SLOTS)
+        nSlotCount = SHAREDMEMORY_MAX_SLOTS;
+      if (sName[0] != '/')
+        sName = "/" + sName;
+      return true;
+    }
+
+    bool Open(RENDERER_SETTINGS & settings)
+    {
+      size_t nPageSize = sysconf(_SC_PAGESIZE);
+      size_t nHeaderSize = (sizeof(SHAREDMEMORY_HEADER) + nPageSize - 1) & ~(nPageSize - 1);
+      size_t nSlotSize = (settings.nWidth * settings.nHeight * 4 + nPageSize - 1) & ~(nPageSize - 1);
+      nMappingSize = nHeaderSize + nSlotSize * nSlotCount;
+
+      hSharedMemory = shm_open( sName.c_str(), O_CREAT | O_RDWR, 0644 );
+      if (hSharedMemory < 0)
+      {
+        printf("[Capture] shm_open(\"%s\") failed\n", sName.c_str());
+        return false;
+      }
+      if (ftruncate( hSharedMemory, nMappingSize ) != 0)
+      {
+        printf("[Capture] Cannot resize shared memory to %u bytes\n", (unsigned int)nMappingSize);
+        Close(); // don't leave a half made object behind for readers to find
+        return false;
+      }
+      pMapping = (unsigned char *)mmap( NULL, nMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, hSharedMemory, 0 );
+      if (pMapping == MAP_FAILED)
+      {
+        pMapping = NULL;
+        printf("[Capture] Cannot map shared memory\n");
+        Close();
+        return false;
+      }
+
+      pHeader = (SHAREDMEMORY_HEADER *)pMapping;
+      memset( pHeader, 0, sizeof(SHAREDMEMORY_HEADER) );
+      pHeader->nVersion = SHAREDMEMORY_VERSION;
+      pHeader->nHeaderSize = nHeaderSize;
+      pHeader->nWidth = settings.nWidth;
+      pHeader->nHeight = settings.nHeight;
+      pHeader->nStride = settings.nWidth * 4;
+      pHeader->nSlotCount = nSlotCount;
+      pHeader->nSlotSize = nSlotSize;
+      __atomic_store_n( &pHeader->nMagic, SHAREDMEMORY_MAGIC, __ATOMIC_RELEASE ); // readers check this last
+
+      printf("[Capture] Publishing frames to shared memory \"%s\" (%d slots)\n", sName.c_str(), nSlotCount);
+      return true;
+    }
+
+    void SendFrame( const Frame * frame )
+    {
+      uint32_t nSlot = nFrameIndex % nSlotCount;
+      nFrameIndex++;
+
+      // seqlock: odd while writing, so readers can tell a torn frame
+      __atomic_store_n( &pHeader->nSlotSequence[nSlot], nFrameIndex * 2 - 1, __ATOMIC_RELAXED );
+      __atomic_thread_fence( __ATOMIC_RELEASE );
+      memcpy( pMapping + pHeader->nHeaderSize + nSlot * pHeader->nSlotSize, frame->pData, pHeader->nStride * pHeader->nHeight );
+
+      timespec ts;
+      clock_gettime( CLOCK_MONOTONIC, &ts );
+      pHeader->nSlotTimestamp[nSlot] = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+      __atomic_store_n( &pHeader->nSlotSequence[nSlot], nFrameIndex * 2, __ATOMIC_RELEASE );
+
+      __atomic_store_n( &pHeader->nLatestSlot, nSlot, __ATOMIC_RELEASE );
+      __atomic_store_n( &pHeader->nFrameIndex, nFrameIndex, __ATOMIC_RELEASE );
+      __atomic_add_fetch( &pHeader->nFutex, 1, __ATOMIC_RELEASE );
+      syscall( SYS_futex, &pHeader->nFutex, FUTEX_WAKE, 0x7FFFFFFF, NULL, NULL, 0 );
+    }
+
+    void Close()
+    {
+      if (pMapping)
+      {
+        munmap( pMapping, nMappingSize );
+        pMapping = NULL;
+      }
+      if (hSharedMemory >= 0)
+      {
+        close( hSharedMemory );
+        shm_unlink( sName.c_str() );
+        hSharedMemory = -1;
+      }
+    }
+  };
+
+  Sink * CreateSharedMemorySink()
+  {
+    return new SharedMemorySink();
+  }
+}
@@ -0,0 +1,36 @@
+// Layout of the shared memory object published by the "sharedMemory" capture
+// sink, so that local consumers can mmap() it and read frames in place.
+//
+// The object starts with a SHAREDMEMORY_HEADER, followed by nSlotCount frame
+// slots of nSlotSize bytes each, the first one at nHeaderSize. Frames are
+// written round-robin into the slots.
+//
+// Reading a frame:
+//   1. wait until nFrameIndex changes (poll, or FUTEX_WAIT on nFutex - it's a
+//      shared, non-private futex),
+//   2. read nLatestSlot, then nSlotSequence[slot] (must be even),
+//   3. use / copy the pixels,
+//   4. re-read nSlotSequence[slot]; if it changed, the writer lapped you and
+//      the pixels may be torn.
+#include <stdint.h>
+
+#define SHAREDMEMORY_MAGIC 0x4D48535A // "ZSHM"
+#define SHAREDMEMORY_VERSION 1
+#define SHAREDMEMORY_MAX_SLOTS 16
+
+typedef struct
+{
+  uint32_t nMagic;
+  uint32_t nVersion;
+  uint32_t nHeaderSize;   // offset of the first slot
+  uint32_t nWidth;
+  uint32_t nHeight;
+  uint32_t nStride;       // bytes per row; pixels are 0xAABBGGRR, top row first
+  uint32_t nSlotCount;
+  uint32_t nSlotSize;     // distance between slots in bytes
+  uint32_t nFutex;        // incremented and woken after every published frame
+  uint32_t nLatestSlot;   // slot holding frame nFrameIndex
+  uint64_t nFrameIndex;   // counts from 1; 0 means nothing was published yet
+  uint64_t nSlotSequence[ SHAREDMEMORY_MAX_SLOTS ];  // odd while the slot is being written
+  uint64_t nSlotTimestamp[ SHAREDMEMORY_MAX_SLOTS ]; // CLOCK_MONOTONIC nanoseconds
+} SHAREDMEMORY_HEADER;
@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
+#include <future>
+#include <algorithm>
 
 #include "ShaderEditor.h"
 #include "Renderer.h"
@@ -11,8 +14,18 @@
 #include "UniConversion.h"
 #include "jsonxx.h"
 #include "Capture.h"
-
-void ReplaceTokens( std::string &sDefShader, const char * sTokenBegin, const char * sTokenName, const char * sTokenEnd, std::vector<std::string> &tokens )
+#include "FramePacing.h"
+#include "Compositor.h"
+#include "Pipeline.h"
+#include "TextureLoader.h"
+#include "OSC.h"
+#include "Parameters.h"
+#include "FileWatcher.h"
+#include "Preprocessor.h"
+#include "Settings.h"
+
+// sTokenIndex, if given, is replaced with the position of the token in the list
+void ReplaceTokens( std::string &sDefShader, const char * sTokenBegin, const char * sTokenName, const char * sTokenEnd, std::vector<std::string> &tokens, const char * sTokenIndex = NULL )
 {
   if (sDefShader.find(sTokenBegin) != std::string::npos
     && sDefShader.find(sTokenName) != std::string::npos
@@ -34,6 +47,12 @@ void ReplaceTokens( std::string &sDefShader, const char * sTokenBegin, const cha
       {
         s.replace( s.find(sTokenName), strlen(sTokenName), tokens[i], 0, std::string::npos );
       }
+      char szIndex[16];
+      sprintf( szIndex, "%d", i );
+      while (sTokenIndex && s.find(sTokenIndex) != std::string::npos)
+      {
+        s.replace( s.find(sTokenIndex), strlen(sTokenIndex), szIndex );
+      }
       sFinalShader += s;
     }
     sFinalShader += sDefShader.substr( sDefShader.find(sTokenEnd) + strlen(sTokenEnd), std::string::npos );
@@ -41,45 +60,135 @@ void ReplaceTokens( std::string &sDefShader, const char * sTokenBegin, const cha
   }
 }
 
+struct ShaderTab
+{
+  ShaderEditor * editor;
+  Renderer::Shader * shader; // NULL until compiled, or after the LRU dropped it
+  std::string sFilename;
+  unsigned int nLastUsed;
+  bool bPinned; // renders a pipeline pass every frame, so it stays compiled
+  std::vector<std::string> includes; // as of the last compile, so a change to one only recompiles the tabs using it
+  std::string sSavedText; // the file as last loaded or saved; the editor differing from it means unsaved edits
+};
+
+// tab 0 keeps the classic file name, the others get a number: shader.glsl, shader_2.glsl, ...
+std::string GetTabFilename( int nTab )
+{
+  std::string sFilename = Renderer::defaultShaderFilename;
+  if (nTab == 0)
+    return sFilename;
+
+  char szSuffix[16];
+  sprintf( szSuffix, "_%d", nTab + 1 );
+  size_t nExtension = sFilename.rfind( '.' );
+  return nExtension == std::string::npos ? sFilename + szSuffix : sFilename.insert( nExtension, szSuffix );
+}
+
+// resolves the includes first, and points the errors back at the files they came from
+Renderer::Shader * CompileTabSource( ShaderTab & tab, const char * szSource, std::string & sError )
+{
+  Preprocessor::OUTPUT output;
+  bool bProcessed = Preprocessor::Process( szSource, tab.sFilename, output, sError );
+  tab.includes.assign( output.files.begin() + 1, output.files.end() );
+  for (int i = 0; i < tab.includes.size(); i++)
+    FileWatcher::Watch( tab.includes[i].c_str() );
+
+  if (!bProcessed)
+    return NULL;
+  Renderer::Shader * shader = Renderer::CompileShader( output.sText.c_str(), output.sText.size(), sError );
+  if (!shader)
+    Preprocessor::MapErrors( output, sError );
+  return shader;
+}
+
+Renderer::Shader * CompileTab( ShaderTab & tab, std::string & sError )
+{
+  return CompileTabSource( tab, tab.editor->GetText(), sError );
+}
+
+// the whole file, however big; false if it can't be read
+bool LoadTextFile( const char * szFilename, std::string & sText )
+{
+  unsigned long long nSize = 0;
+  unsigned long long nModified = 0;
+  if (!Misc::GetFileStamp( szFilename, nSize, nModified ))
+    return false;
+
+  size_t nMappedSize = 0;
+  const char * pData = nSize ? (const char *)Misc::MapFile( szFilename, nMappedSize ) : NULL;
+  if (nSize && !pData)
+    return false;
+  sText.assign( pData ? pData : "", nMappedSize );
+  sText.resize( strlen( sText.c_str() ) ); // everything downstream stops at the first NUL anyway
+  if (pData)
+    Misc::UnmapFile( pData, nMappedSize );
+  return true;
+}
+
+// compiled programs sit in GPU memory; keep the nMax most recently used, never dropping pKeep (the one on screen)
+// or the one a transition is still fading out
+void TrimCompiledShaders( std::vector<ShaderTab> & tabs, int nMax, Renderer::Shader * pKeep )
+{
+  while (true)
+  {
+    int nCompiled = 0;
+    int nOldest = -1;
+    for (int i = 0; i < tabs.size(); i++)
+    {
+      if (!tabs[i].shader || tabs[i].bPinned)
+        continue;
+      nCompiled++;
+      if (tabs[i].shader != pKeep && tabs[i].shader != Compositor::GetOutgoingShader() && (nOldest < 0 || tabs[i].nLastUsed < tabs[nOldest].nLastUsed))
+        nOldest = i;
+    }
+    if (nCompiled <= nMax || nOldest < 0)
+      break;
+
+    Renderer::ReleaseShader( tabs[nOldest].shader );
+    tabs[nOldest].shader = NULL;
+  }
+}
+
+// a texture file that changed, being decoded off the render thread
+struct TextureReload
+{
+  int nTexture; // in shaderTextures
+  std::vector<TextureLoader::IMAGE> images;
+  std::future<void> decoded;
+};
+
 int main(int argc, const char *argv[])
 {
   Misc::PlatformStartup();
 
   jsonxx::Object options;
-  FILE * fConf = fopen( (argc > 1) ? argv[1] : "config.json","rb");
-  if (fConf)
+  std::string sConfigFilename = (argc > 1) ? argv[1] : "config.json";
+  std::string sConfig;
+  if (LoadTextFile( sConfigFilename.c_str(), sConfig ))
   {
     printf("Config file found, parsing...\n");
-
-    char szConfig[65535];
-    memset( szConfig, 0, 65535 );
-    int n = fread( szConfig, 1, 65535, fConf );
-    fclose(fConf);
-
-    options.parse( szConfig );
+    options.parse( sConfig );
   }
+  Settings::CONFIG config;
+  Settings::Parse( options, config );
 
   RENDERER_SETTINGS settings;
-  settings.bVsync = false;
+  FramePacing::GetModeFromName( config.rendering.sFramePacing.c_str(), settings.framePacing );
+  settings.fTargetFrameRate = config.rendering.fTargetFrameRate;
+  settings.bVsync = settings.framePacing == RENDERER_FRAMEPACING_VSYNC || settings.framePacing == RENDERER_FRAMEPACING_ADAPTIVE;
 #ifdef _DEBUG
   settings.nWidth = 1280;
   settings.nHeight = 720;
   settings.windowMode = RENDERER_WINDOWMODE_WINDOWED;
 #else
-  settings.nWidth = 1920;
-  settings.nHeight = 1080;
-  settings.windowMode = RENDERER_WINDOWMODE_FULLSCREEN;
-  if (options.has<jsonxx::Object>("window"))
-  {
-    if (options.get<jsonxx::Object>("window").has<jsonxx::Number>("width"))
-      settings.nWidth = options.get<jsonxx::Object>("window").get<jsonxx::Number>("width");
-    if (options.get<jsonxx::Object>("window").has<jsonxx::Number>("height"))
-      settings.nHeight = options.get<jsonxx::Object>("window").get<jsonxx::Number>("height");
-    if (options.get<jsonxx::Object>("window").has<jsonxx::Boolean>("fullscreen"))
-      settings.windowMode = options.get<jsonxx::Object>("window").get<jsonxx::Boolean>("fullscreen") ? RENDERER_WINDOWMODE_FULLSCREEN : RENDERER_WINDOWMODE_WINDOWED;
-  }
+  settings.nWidth = config.window.nWidth;
+  settings.nHeight = config.window.nHeight;
+  settings.windowMode = config.window.bFullscreen ? RENDERER_WINDOWMODE_FULLSCREEN : RENDERER_WINDOWMODE_WINDOWED;
+  bool bConfigVsync = settings.bVsync;
   if (!Renderer::OpenSetupDialog( &settings ))
     return -1;
+  if (settings.bVsync != bConfigVsync) // the dialog only knows on/off, so only override the config if it was toggled
+    settings.framePacing = settings.bVsync ? RENDERER_FRAMEPACING_VSYNC : RENDERER_FRAMEPACING_UNCAPPED;
 #endif
 
   if (!Renderer::Open( &settings ))
@@ -100,101 +209,81 @@ int main(int argc, const char *argv[])
     //return -1;
   }
 
-  std::map<std::string,Renderer::Texture*> textures;
-  std::map<int,std::string> midiRoutes;
+  // everything the shaders sample, by index in the renderer's texture name table so the frame
+  // binds them without any name lookups: the config textures first (the ones in the preview),
+  // then the FFT / MIDI ones; the pass names follow, but their buffers come from Pipeline
+  std::vector<std::string> shaderTextureNames;
+  std::vector<Renderer::Texture*> shaderTextures;
+  int nConfigTextureCount = 0;
+  std::map<std::string,int> textureFiles; // file -> index in shaderTextures, for the hot reload
 
   SHADEREDITOR_OPTIONS editorOptions;
-  editorOptions.nFontSize = 16;
+  editorOptions.nFontSize = config.font.nSize;
   editorOptions.sFontPath = Misc::GetDefaultFontPath();
-  editorOptions.nOpacity = 0xC0;
-  editorOptions.bUseSpacesForTabs = true;
-  editorOptions.nTabSize = 2;
-  editorOptions.bVisibleWhitespace = false;
-
-  int nDebugOutputHeight = 200;
-  int nTexPreviewWidth = 64;
-  float fFFTSmoothingFactor = 0.9f; // higher value, smoother FFT
+  editorOptions.nOpacity = config.gui.nOpacity;
+  editorOptions.bUseSpacesForTabs = config.gui.bSpacesForTabs;
+  editorOptions.nTabSize = config.gui.nTabSize;
+  editorOptions.bVisibleWhitespace = config.gui.bVisibleWhitespace;
+  editorOptions.bDistanceFieldFont = config.font.bDistanceField;
+  if (config.font.sFile.size() && Misc::FileExists( config.font.sFile.c_str() ))
+    editorOptions.sFontPath = config.font.sFile;
+  if (!editorOptions.sFontPath.size()) // coudn't find a default font
+  {
+    printf("Couldn't find any of the default fonts. Please specify one in config.json\n");
+    return -1;
+  }
+
+  int nDebugOutputHeight = config.gui.nOutputHeight;
+  int nTexPreviewWidth = config.gui.nTexturePreviewWidth;
   float fFFTSlightSmoothingFactor = 0.6f; // higher value, smoother FFT
 
-  std::string sPostExitCmd;
+  int nTabCount = config.tabs.nCount;
 
-  if (!options.empty())
+  TextureLoader::SETTINGS textureSettings;
+  textureSettings.bMipmaps = config.rendering.bTextureMipmaps;
+  textureSettings.bCompress = config.rendering.bTextureCompression;
+  textureSettings.sCacheDir = config.rendering.sTextureCache;
+
+  if (config.textures.size())
   {
-    if (options.has<jsonxx::Object>("rendering"))
+    printf("Loading textures...\n");
+    std::vector<TextureLoader::IMAGE> images( config.textures.size() );
+    for (int i = 0; i < config.textures.size(); i++)
     {
-      if (options.get<jsonxx::Object>("rendering").has<jsonxx::Number>("fftSmoothFactor"))
-        fFFTSmoothingFactor = options.get<jsonxx::Object>("rendering").get<jsonxx::Number>("fftSmoothFactor");
+      printf("* %s...\n", config.textures[i].sFilename.c_str());
+      images[i].sFilename = config.textures[i].sFilename;
     }
 
-    if (options.has<jsonxx::Object>("textures"))
+    // decoding happens on worker threads, the upload has to stay on this one
+    TextureLoader::Load( images, textureSettings );
+    for (int i = 0; i < images.size(); i++)
     {
-      printf("Loading textures...\n");
-      std::map<std::string, jsonxx::Value*> tex = options.get<jsonxx::Object>("textures").kv_map();
-      for (std::map<std::string, jsonxx::Value*>::iterator it = tex.begin(); it != tex.end(); it++)
+      Renderer::Texture * tex = images[i].bValid ? Renderer::CreateTextureFromMipLevels( images[i].format, &images[i].levels[0], (int)images[i].levels.size() ) : NULL;
+      if (!tex)
       {
-        const char * fn = it->second->string_value_->c_str();
-        printf("* %s...\n",fn);
-        Renderer::Texture * tex = Renderer::CreateRGBA8TextureFromFile( fn );
-        if (!tex)
-        {
-          printf("Renderer::CreateRGBA8TextureFromFile(%s) failed\n",fn);
-          return -1;
-        }
-        textures[it->first] = tex;
+        printf("Cannot load texture %s, shaders won't have %s\n", images[i].sFilename.c_str(), config.textures[i].sName.c_str());
+        continue;
       }
-    }
-    if (options.has<jsonxx::Object>("font"))
-    {
-      if (options.get<jsonxx::Object>("font").has<jsonxx::Number>("size"))
-        editorOptions.nFontSize = options.get<jsonxx::Object>("font").get<jsonxx::Number>("size");
-      if (options.get<jsonxx::Object>("font").has<jsonxx::String>("file"))
+      int nTexture = std::find( shaderTextureNames.begin(), shaderTextureNames.end(), config.textures[i].sName ) - shaderTextureNames.begin();
+      if (nTexture == shaderTextureNames.size())
       {
-        std::string fontpath = options.get<jsonxx::Object>("font").get<jsonxx::String>("file");
-        if (Misc::FileExists(fontpath.c_str()))
-        {
-          editorOptions.sFontPath = fontpath;
-        }
+        shaderTextureNames.push_back( config.textures[i].sName );
+        shaderTextures.push_back( NULL );
       }
-      else if (!editorOptions.sFontPath.size()) // coudn't find a default font
-      {
-        printf("Couldn't find any of the default fonts. Please specify one in config.json\n");
-        return -1;
-      }
-    }
-    if (options.has<jsonxx::Object>("gui"))
-    {
-      if (options.get<jsonxx::Object>("gui").has<jsonxx::Number>("outputHeight"))
-        nDebugOutputHeight = options.get<jsonxx::Object>("gui").get<jsonxx::Number>("outputHeight");
-      if (options.get<jsonxx::Object>("gui").has<jsonxx::Number>("texturePreviewWidth"))
-        nTexPreviewWidth = options.get<jsonxx::Object>("gui").get<jsonxx::Number>("texturePreviewWidth");
-      if (options.get<jsonxx::Object>("gui").has<jsonxx::Number>("opacity"))
-        editorOptions.nOpacity = options.get<jsonxx::Object>("gui").get<jsonxx::Number>("opacity");
-      if (options.get<jsonxx::Object>("gui").has<jsonxx::Boolean>("spacesForTabs"))
-        editorOptions.bUseSpacesForTabs = options.get<jsonxx::Object>("gui").get<jsonxx::Boolean>("spacesForTabs");
-      if (options.get<jsonxx::Object>("gui").has<jsonxx::Number>("tabSize"))
-        editorOptions.nTabSize = options.get<jsonxx::Object>("gui").get<jsonxx::Number>("tabSize");
-      if (options.get<jsonxx::Object>("gui").has<jsonxx::Boolean>("visibleWhitespace"))
-        editorOptions.bVisibleWhitespace = options.get<jsonxx::Object>("gui").get<jsonxx::Boolean>("visibleWhitespace");
-    }
-    if (options.has<jsonxx::Object>("midi"))
-    {
-      std::map<std::string, jsonxx::Value*> tex = options.get<jsonxx::Object>("midi").kv_map();
-      for (std::map<std::string, jsonxx::Value*>::iterator it = tex.begin(); it != tex.end(); it++)
+      else
       {
-        midiRoutes[it->second->number_value_] = it->first;
+        Renderer::ReleaseTexture( shaderTextures[ nTexture ] ); // the same name twice, the last one wins
       }
+      shaderTextures[ nTexture ] = tex;
+      textureFiles[ images[i].sFilename ] = nTexture;
     }
-    if (options.has<jsonxx::String>("postExitCmd"))
-    {
-      sPostExitCmd = options.get<jsonxx::String>("postExitCmd");
-    }
-    Capture::LoadSettings( options );
-  }
-  else if (!editorOptions.sFontPath.size())
-  {
-    printf("Couldn't find any of the default fonts. Please specify one in config.json\n");
-    return -1;
+    nConfigTextureCount = (int)shaderTextures.size();
   }
+  Capture::LoadSettings( options );
+  Pipeline::LoadSettings( options );
+  OSC::LoadSettings( options );
+  Parameters::LoadSettings( options );
+  Preprocessor::LoadSettings( options );
   if (!Capture::Open(settings))
   {
     printf("Initializing capture system failed!\n");
@@ -204,51 +293,92 @@ int main(int argc, const char *argv[])
   Renderer::Texture * texFFT = Renderer::Create1DR32Texture( FFT_SIZE );
   Renderer::Texture * texFFTSmoothed = Renderer::Create1DR32Texture( FFT_SIZE );
   Renderer::Texture * texFFTIntegrated = Renderer::Create1DR32Texture( FFT_SIZE );
-
-  bool shaderInitSuccessful = false;
-  char szShader[65535];
-  char szError[4096];
-  FILE * f = fopen(Renderer::defaultShaderFilename,"rb");
-  if (f)
+  Renderer::Texture * texMIDI = Renderer::CreateRGBA32FTexture( MIDI_STATE_TEXTURE_WIDTH, MIDI_STATE_TEXTURE_HEIGHT );
+  Renderer::Texture * texMIDIHistory = Renderer::CreateRGBA32FTexture( MIDI_HISTORY_SIZE, 1 );
+  const char * szBuiltinTextureNames[] = { "texFFT", "texFFTSmoothed", "texFFTIntegrated", "texMIDI", "texMIDIHistory" };
+  Renderer::Texture * builtinTextures[] = { texFFT, texFFTSmoothed, texFFTIntegrated, texMIDI, texMIDIHistory };
+  for (int i = 0; i < sizeof(builtinTextures) / sizeof(builtinTextures[0]); i++)
   {
-    printf("Loading last shader...\n");
-
-    memset( szShader, 0, 65535 );
-    int n = fread( szShader, 1, 65535, f );
-    fclose(f);
-    if (Renderer::ReloadShader( szShader, strlen(szShader), szError, 4096 ))
-    {
-      printf("Last shader works fine.\n");
-      shaderInitSuccessful = true;
-    }
-    else {
-      printf("Shader error:\n%s\n", szError);
-    }
+    shaderTextureNames.push_back( szBuiltinTextureNames[i] );
+    shaderTextures.push_back( builtinTextures[i] );
   }
-  if (!shaderInitSuccessful)
-  {
-    printf("No valid last shader found, falling back to default...\n");
-
-    std::string sDefShader = Renderer::defaultShader;
-
-    std::vector<std::string> tokens;
-    for (std::map<std::string, Renderer::Texture*>::iterator it = textures.begin(); it != textures.end(); it++)
-      tokens.push_back(it->first);
-    ReplaceTokens(sDefShader, "{%textures:begin%}", "{%textures:name%}", "{%textures:end%}", tokens);
 
-    tokens.clear();
-    for (std::map<int,std::string>::iterator it = midiRoutes.begin(); it != midiRoutes.end(); it++)
-      tokens.push_back(it->second);
-    ReplaceTokens(sDefShader, "{%midi:begin%}", "{%midi:name%}", "{%midi:end%}", tokens);
+  OSC::Open();
+
+  if (!Pipeline::Open( settings.nWidth, settings.nHeight, nTabCount ))
+    printf("Pipeline::Open failed, continuing without passes...\n");
+
+  int nFirstPassTexture = (int)shaderTextureNames.size();
+  for (int i = 0; i < Pipeline::GetPassCount(); i++)
+    shaderTextureNames.push_back( Pipeline::GetPassName(i) );
+  Renderer::SetShaderTextureNames( shaderTextureNames );
+
+  std::string sDefShader = Renderer::defaultShader;
+
+  std::vector<std::string> tokens;
+  for (int i = 0; i < nConfigTextureCount; i++)
+    tokens.push_back(shaderTextureNames[i]);
+  for (int i = 0; i < Pipeline::GetPassCount(); i++)
+    tokens.push_back(Pipeline::GetPassName(i));
+  ReplaceTokens(sDefShader, "{%textures:begin%}", "{%textures:name%}", "{%textures:end%}", tokens);
+
+  tokens.clear();
+  for (int i = 0; i < Parameters::GetCount(); i++)
+    tokens.push_back(Parameters::GetName(i));
+  ReplaceTokens(sDefShader, "{%midi:begin%}", "{%midi:name%}", "{%midi:end%}", tokens, "{%midi:index%}");
+
+  // backwards, so that tab 0 ends up most recently used; tabs past the
+  // LRU budget are only compiled once they're switched to
+  std::string sShader; // what F5 compiled, to be saved once it has rendered
+  std::string sError;
+  std::vector<ShaderTab> tabs( nTabCount );
+  std::vector<std::string> tabTexts( nTabCount );
+  unsigned int nTabClock = 0;
+  for (int i = nTabCount - 1; i >= 0; i--)
+  {
+    tabs[i].editor = NULL;
+    tabs[i].shader = NULL;
+    tabs[i].sFilename = GetTabFilename( i );
+    tabs[i].nLastUsed = ++nTabClock;
+    tabs[i].bPinned = false;
+    for (int j = 0; j < Pipeline::GetPassCount(); j++)
+      tabs[i].bPinned |= Pipeline::GetPassTab(j) == i;
+    bool bCompile = i < config.tabs.nKeepCompiled || tabs[i].bPinned;
+
+    bool shaderInitSuccessful = false;
+    if (LoadTextFile( tabs[i].sFilename.c_str(), tabTexts[i] ))
+    {
+      printf("Loading last shader (%s)...\n", tabs[i].sFilename.c_str());
 
-    strncpy( szShader, sDefShader.c_str(), 65535 );
-    if (!Renderer::ReloadShader( szShader, strlen(szShader), szError, 4096 ))
+      if (!bCompile)
+      {
+        shaderInitSuccessful = true;
+      }
+      else if ((tabs[i].shader = CompileTabSource( tabs[i], tabTexts[i].c_str(), sError )) != NULL)
+      {
+        printf("Last shader works fine.\n");
+        shaderInitSuccessful = true;
+      }
+      else {
+        printf("Shader error:\n%s\n", sError.c_str());
+      }
+    }
+    if (!shaderInitSuccessful)
     {
-      printf("Default shader compile failed:\n");
-      puts(szError);
-      assert(0);
+      printf("No valid last shader found, falling back to default...\n");
+
+      tabTexts[i] = sDefShader;
+      if (bCompile && (tabs[i].shader = Renderer::CompileShader( tabTexts[i].c_str(), tabTexts[i].size(), sError )) == NULL)
+      {
+        printf("Default shader compile failed:\n");
+        puts(sError.c_str());
+        assert(0);
+      }
     }
+    tabs[i].sSavedText = tabTexts[i]; // the editor's starting point, so a fixed file on disk still replaces the fallback
   }
+  int nActiveTab = 0;
+  Renderer::Shader * pCurrentShader = tabs[0].shader;
 
   Misc::InitKeymaps();
 
@@ -263,9 +393,14 @@ int main(int argc, const char *argv[])
   bool bTexPreviewVisible = true;
 
   editorOptions.rect = Scintilla::PRectangle( nMargin, nMargin, settings.nWidth - nMargin - nTexPreviewWidth - nMargin, settings.nHeight - nMargin * 2 - nDebugOutputHeight );
-  ShaderEditor mShaderEditor( surface );
-  mShaderEditor.Initialise( editorOptions );
-  mShaderEditor.SetText( szShader );
+  for (int i = 0; i < nTabCount; i++)
+  {
+    tabs[i].editor = new ShaderEditor( surface );
+    tabs[i].editor->Initialise( editorOptions );
+    tabs[i].editor->SetText( tabTexts[i].c_str() );
+  }
+  tabTexts.clear();
+  ShaderEditor * mShaderEditor = tabs[nActiveTab].editor;
 
   editorOptions.rect = Scintilla::PRectangle( nMargin, settings.nHeight - nMargin - nDebugOutputHeight, settings.nWidth - nMargin - nTexPreviewWidth - nMargin, settings.nHeight - nMargin );
   ShaderEditor mDebugOutput( surface );
@@ -284,13 +419,40 @@ int main(int argc, const char *argv[])
   static float fftDataIntegrated[FFT_SIZE];
   memset(fftDataIntegrated, 0, sizeof(float) * FFT_SIZE);
 
+  static float midiState[MIDI_STATE_TEXTURE_WIDTH * MIDI_STATE_TEXTURE_HEIGHT * 4];
+  static float midiHistory[MIDI_HISTORY_SIZE * 4];
+
+  if (!Compositor::Open( settings.nWidth, settings.nHeight, config.transition.sType.c_str(), config.transition.fDuration, config.transition.fOutgoingScale ))
+    printf("Compositor::Open failed, shader changes will be hard cuts\n");
+
+  // files changed on disk; the ones that can't be applied yet stay here until a later frame
+  std::vector<std::string> changedFiles;
+  std::vector<TextureReload*> textureReloads;
+  if (config.hotReload.bEnabled && FileWatcher::Open( config.hotReload.nDebounce ))
+  {
+    for (int i = 0; i < nTabCount; i++)
+    {
+      FileWatcher::Watch( tabs[i].sFilename.c_str() );
+      for (int j = 0; j < tabs[i].includes.size(); j++)
+        FileWatcher::Watch( tabs[i].includes[j].c_str() );
+    }
+    for (std::map<std::string, int>::iterator it = textureFiles.begin(); it != textureFiles.end(); it++)
+      FileWatcher::Watch( it->first.c_str() );
+    FileWatcher::Watch( sConfigFilename.c_str() );
+  }
+
   bool bShowGui = true;
+  FramePacing::Open( settings, config.rendering.fFrameStatsInterval );
   Timer::Start();
-  float fNextTick = 0.1f;
+  double fNextTick = 0.1;
+  unsigned long long nLastFrameTime = 0;
+  int nFrameIndex = 0;
   while (!Renderer::WantsToQuit())
   {
     bool newShader = false;
-    float time = Timer::GetTime() / 1000.0; // seconds
+    int nSavedTab = 0;
+    unsigned long long nFrameTime = Timer::GetTimeNS();
+    double time = nFrameTime / 1000000000.0; // seconds; kept in double, a float runs out of sub-frame precision after a few hours
     Renderer::StartFrame();
 
     for(int i=0; i<Renderer::mouseEventBufferCount; i++)
@@ -300,16 +462,16 @@ int main(int argc, const char *argv[])
         switch (Renderer::mouseEventBuffer[i].eventType)
         {
           case Renderer::MOUSEEVENTTYPE_MOVE:
-            mShaderEditor.ButtonMovePublic( Scintilla::Point( Renderer::mouseEventBuffer[i].x, Renderer::mouseEventBuffer[i].y ) );
+            mShaderEditor->ButtonMovePublic( Scintilla::Point( Renderer::mouseEventBuffer[i].x, Renderer::mouseEventBuffer[i].y ) );
             break;
           case Renderer::MOUSEEVENTTYPE_DOWN:
-            mShaderEditor.ButtonDown( Scintilla::Point( Renderer::mouseEventBuffer[i].x, Renderer::mouseEventBuffer[i].y ), time * 1000, false, false, false );
+            mShaderEditor->ButtonDown( Scintilla::Point( Renderer::mouseEventBuffer[i].x, Renderer::mouseEventBuffer[i].y ), time * 1000, false, false, false );
             break;
           case Renderer::MOUSEEVENTTYPE_UP:
-            mShaderEditor.ButtonUp( Scintilla::Point( Renderer::mouseEventBuffer[i].x, Renderer::mouseEventBuffer[i].y ), time * 1000, false );
+            mShaderEditor->ButtonUp( Scintilla::Point( Renderer::mouseEventBuffer[i].x, Renderer::mouseEventBuffer[i].y ), time * 1000, false );
             break;
           case Renderer::MOUSEEVENTTYPE_SCROLL:
-            mShaderEditor.WndProc( SCI_LINESCROLL, -Renderer::mouseEventBuffer[i].x, -Renderer::mouseEventBuffer[i].y);
+            mShaderEditor->WndProc( SCI_LINESCROLL, -Renderer::mouseEventBuffer[i].x, -Renderer::mouseEventBuffer[i].y);
             break;
         }
       }
@@ -322,29 +484,65 @@ int main(int argc, const char *argv[])
       {
         if (bTexPreviewVisible)
         {
-          mShaderEditor.SetPosition( Scintilla::PRectangle( nMargin, nMargin, settings.nWidth - nMargin, settings.nHeight - nMargin * 2 - nDebugOutputHeight ) );
+          for (int j = 0; j < nTabCount; j++)
+            tabs[j].editor->SetPosition( Scintilla::PRectangle( nMargin, nMargin, settings.nWidth - nMargin, settings.nHeight - nMargin * 2 - nDebugOutputHeight ) );
           mDebugOutput .SetPosition( Scintilla::PRectangle( nMargin, settings.nHeight - nMargin - nDebugOutputHeight, settings.nWidth - nMargin, settings.nHeight - nMargin ) );
           bTexPreviewVisible = false;
         }
         else
         {
-          mShaderEditor.SetPosition( Scintilla::PRectangle( nMargin, nMargin, settings.nWidth - nMargin - nTexPreviewWidth - nMargin, settings.nHeight - nMargin * 2 - nDebugOutputHeight ) );
+          for (int j = 0; j < nTabCount; j++)
+            tabs[j].editor->SetPosition( Scintilla::PRectangle( nMargin, nMargin, settings.nWidth - nMargin - nTexPreviewWidth - nMargin, settings.nHeight - nMargin * 2 - nDebugOutputHeight ) );
           mDebugOutput .SetPosition( Scintilla::PRectangle( nMargin, settings.nHeight - nMargin - nDebugOutputHeight, settings.nWidth - nMargin - nTexPreviewWidth - nMargin, settings.nHeight - nMargin ) );
           bTexPreviewVisible = true;
         }
       }
       else if (Renderer::keyEventBuffer[i].scanCode == 286 || (Renderer::keyEventBuffer[i].ctrl && Renderer::keyEventBuffer[i].scanCode == 'r')) // F5
       {
-        mShaderEditor.GetText(szShader,65535);
-        if (Renderer::ReloadShader( szShader, strlen(szShader), szError, 4096 ))
+        const char * szText = mShaderEditor->GetText();
+        Renderer::Shader * shader = CompileTabSource( tabs[nActiveTab], szText, sError );
+        if (shader)
         {
           // Shader compilation successful; we set a flag to save if the frame render was successful
           // (If there is a driver crash, don't save.)
+          // the old program of this tab is only referenced by the transition from here on, so it takes ownership
+          Renderer::Shader * pOldShader = tabs[nActiveTab].shader;
+          Compositor::Start( pCurrentShader, pCurrentShader == pOldShader, time );
+          if (pOldShader != pCurrentShader)
+            Renderer::ReleaseShader( pOldShader );
+          tabs[nActiveTab].shader = pCurrentShader = shader;
+          sShader = szText;
+          nSavedTab = nActiveTab;
           newShader = true;
+          TrimCompiledShaders( tabs, config.tabs.nKeepCompiled, pCurrentShader );
         }
         else
         {
-          mDebugOutput.SetText( szError );
+          mDebugOutput.SetText( sError.c_str() );
+        }
+      }
+      else if (Renderer::keyEventBuffer[i].ctrl && Renderer::keyEventBuffer[i].scanCode >= '1' && Renderer::keyEventBuffer[i].scanCode < '1' + nTabCount) // Ctrl-1 .. Ctrl-9
+      {
+        int nTab = Renderer::keyEventBuffer[i].scanCode - '1';
+        if (nTab != nActiveTab)
+        {
+          // a warm tab is just a program bind; a cold one gets compiled now, and if that fails the old picture stays
+          nActiveTab = nTab;
+          mShaderEditor = tabs[nActiveTab].editor;
+          tabs[nActiveTab].nLastUsed = ++nTabClock;
+          if (!tabs[nActiveTab].shader)
+            tabs[nActiveTab].shader = CompileTab( tabs[nActiveTab], sError );
+          if (tabs[nActiveTab].shader)
+          {
+            Compositor::Start( pCurrentShader, false, time );
+            pCurrentShader = tabs[nActiveTab].shader;
+            mDebugOutput.SetText( "" );
+          }
+          else
+          {
+            mDebugOutput.SetText( sError.c_str() );
+          }
+          TrimCompiledShaders( tabs, config.tabs.nKeepCompiled, pCurrentShader );
         }
       }
       else if (Renderer::keyEventBuffer[i].scanCode == 292 || (Renderer::keyEventBuffer[i].ctrl && Renderer::keyEventBuffer[i].scanCode == 'f')) // F11 or Ctrl/Cmd-f  
@@ -356,7 +554,7 @@ int main(int argc, const char *argv[])
         bool consumed = false;
         if (Renderer::keyEventBuffer[i].scanCode)
         {
-          mShaderEditor.KeyDown(
+          mShaderEditor->KeyDown(
             iswalpha(Renderer::keyEventBuffer[i].scanCode) ? towupper(Renderer::keyEventBuffer[i].scanCode) : Renderer::keyEventBuffer[i].scanCode,
             Renderer::keyEventBuffer[i].shift,
             Renderer::keyEventBuffer[i].ctrl,
@@ -368,21 +566,195 @@ int main(int argc, const char *argv[])
           char    utf8[5] = {0,0,0,0,0};
           wchar_t utf16[2] = {Renderer::keyEventBuffer[i].character, 0};
           Scintilla::UTF8FromUTF16(utf16, 1, utf8, 4 * sizeof(char));
-          mShaderEditor.AddCharUTF(utf8, strlen(utf8));
+          mShaderEditor->AddCharUTF(utf8, strlen(utf8));
         }
 
       }
     }
     Renderer::keyEventBufferCount = 0;
 
-    Renderer::SetShaderConstant( "fGlobalTime", time );
-    Renderer::SetShaderConstant( "v2Resolution", settings.nWidth, settings.nHeight );
+    // hot reload: shaders have to be compiled on this thread (GL contexts don't travel), but
+    // only once the file has settled; textures are decoded in the background and only swapped
+    // in once they're ready, so the frame never waits on the disk
+    std::string sChangedFile;
+    while (FileWatcher::PopChange( sChangedFile ))
+    {
+      if (std::find( changedFiles.begin(), changedFiles.end(), sChangedFile ) == changedFiles.end())
+        changedFiles.push_back( sChangedFile );
+    }
+    for (int i = 0; i < changedFiles.size(); )
+    {
+      if (changedFiles[i] == sConfigFilename)
+      {
+        // only what can change without recreating anything; the rest says it needs a restart
+        printf("[HotReload] %s changed on disk\n", changedFiles[i].c_str());
+        jsonxx::Object newOptions;
+        if (LoadTextFile( sConfigFilename.c_str(), sConfig ) && newOptions.parse( sConfig ))
+        {
+          Settings::CONFIG newConfig;
+          Settings::Parse( newOptions, newConfig );
+          Settings::ApplyChanges( config, newConfig );
+          for (int j = 0; j < nTabCount; j++)
+            tabs[j].editor->SetOpacity( config.gui.nOpacity );
+          mDebugOutput.SetOpacity( config.gui.nOpacity );
+          TrimCompiledShaders( tabs, config.tabs.nKeepCompiled, pCurrentShader );
+          Parameters::Reload( newOptions );
+        }
+        else
+        {
+          printf("[HotReload] %s doesn't parse, keeping the current settings\n", sConfigFilename.c_str());
+        }
+        changedFiles.erase( changedFiles.begin() + i );
+        continue;
+      }
 
-    for (std::map<int,std::string>::iterator it = midiRoutes.begin(); it != midiRoutes.end(); it++)
+      bool bDone = true;
+      int nTab = -1;
+      for (int j = 0; j < nTabCount; j++)
+        nTab = tabs[j].sFilename == changedFiles[i] ? j : nTab;
+
+      // the tabs to recompile: the one whose file it is, or the ones including it
+      std::vector<int> affectedTabs;
+      std::string sFileText;
+      if (nTab >= 0)
+      {
+        // otherwise it's gone, or our own save after F5; edits made since the last save are never overwritten
+        if (LoadTextFile( changedFiles[i].c_str(), sFileText ) && sFileText != tabs[nTab].sSavedText)
+        {
+          if (tabs[nTab].sSavedText != tabs[nTab].editor->GetText())
+          {
+            printf("[HotReload] %s changed on disk, but tab %d has unsaved edits\n", changedFiles[i].c_str(), nTab + 1);
+            mDebugOutput.SetText( (changedFiles[i] + " changed on disk, but the tab has unsaved edits; kept them, F5 saves them over the file").c_str() );
+            tabs[nTab].sSavedText = sFileText;
+          }
+          else
+          {
+            affectedTabs.push_back( nTab );
+          }
+        }
+      }
+      else if (!textureFiles.count( changedFiles[i] ))
+      {
+        for (int j = 0; j < nTabCount; j++)
+        {
+          if (std::find( tabs[j].includes.begin(), tabs[j].includes.end(), changedFiles[i] ) != tabs[j].includes.end())
+            affectedTabs.push_back( j );
+        }
+      }
+      for (int j = 0; j < affectedTabs.size(); j++)
+      {
+        int nAffected = affectedTabs[j];
+        if (nAffected != nActiveTab && tabs[nAffected].shader && tabs[nAffected].shader == Compositor::GetOutgoingShader())
+          bDone = false; // still fading out; the transition ends soon enough
+      }
+      if (bDone && nTab < 0 && affectedTabs.size() && !Preprocessor::Refresh( changedFiles[i] ))
+        affectedTabs.clear(); // saved without changes
+
+      if (bDone && affectedTabs.size())
+      {
+        printf("[HotReload] %s changed on disk\n", changedFiles[i].c_str());
+        if (nTab >= 0)
+        {
+          tabs[nTab].editor->SetText( sFileText.c_str() );
+          tabs[nTab].sSavedText = sFileText;
+        }
+
+        for (int j = 0; j < affectedTabs.size(); j++)
+        {
+          ShaderTab & tab = tabs[ affectedTabs[j] ];
+          bool bActive = affectedTabs[j] == nActiveTab;
+
+          // cold tabs pick the change up when they're switched to; a pinned tab whose program failed gets another go
+          bool bCompile = tab.shader || tab.bPinned || bActive;
+          Renderer::Shader * shader = bCompile ? CompileTab( tab, sError ) : NULL;
+          if (shader)
+          {
+            Renderer::Shader * pOldShader = tab.shader;
+            // after a failed switch to a cold tab the screen still shows this tab's program, so it's replaced there too
+            if (bActive || (pOldShader && pOldShader == pCurrentShader))
+            {
+              Compositor::Start( pCurrentShader, pCurrentShader == pOldShader, time );
+              if (pOldShader && pOldShader != pCurrentShader)
+                Renderer::ReleaseShader( pOldShader );
+              pCurrentShader = shader;
+            }
+            else
+            {
+              Renderer::ReleaseShader( pOldShader );
+            }
+            tab.shader = shader;
+            mDebugOutput.SetText( "" );
+          }
+          else if (bCompile)
+          {
+            mDebugOutput.SetText( sError.c_str() ); // the old program keeps running
+          }
+        }
+      }
+      if (textureFiles.count( changedFiles[i] ))
+      {
+        int nTexture = textureFiles[ changedFiles[i] ];
+        for (int j = 0; j < textureReloads.size(); j++)
+          bDone &= textureReloads[j]->nTexture != nTexture; // one at a time per texture, so they can't land out of order
+        if (bDone)
+        {
+          printf("[HotReload] %s changed on disk\n", changedFiles[i].c_str());
+          TextureReload * reload = new TextureReload();
+          reload->nTexture = nTexture;
+          reload->images.push_back( TextureLoader::IMAGE() );
+          reload->images.back().sFilename = changedFiles[i];
+          reload->decoded = std::async( std::launch::async, TextureLoader::Load, std::ref( reload->images ), std::cref( textureSettings ) );
+          textureReloads.push_back( reload );
+        }
+      }
+
+      if (bDone)
+        changedFiles.erase( changedFiles.begin() + i );
+      else
+        i++;
+    }
+    for (int i = 0; i < textureReloads.size(); )
     {
-      Renderer::SetShaderConstant( it->second.c_str(), MIDI::GetCCValue( it->first ) );
+      TextureReload * reload = textureReloads[i];
+      if (reload->decoded.wait_for( std::chrono::seconds( 0 ) ) != std::future_status::ready)
+      {
+        i++;
+        continue;
+      }
+      TextureLoader::IMAGE & image = reload->images[0];
+      Renderer::Texture * tex = image.bValid ? Renderer::CreateTextureFromMipLevels( image.format, &image.levels[0], (int)image.levels.size() ) : NULL;
+      if (tex)
+      {
+        Renderer::ReleaseTexture( shaderTextures[ reload->nTexture ] );
+        shaderTextures[ reload->nTexture ] = tex;
+      }
+      else
+      {
+        printf("[HotReload] Cannot load %s, keeping the previous %s\n", image.sFilename.c_str(), shaderTextureNames[ reload->nTexture ].c_str());
+      }
+      delete reload;
+      textureReloads.erase( textureReloads.begin() + i );
     }
 
+    double fShaderTime = config.rendering.fTimeWrapPeriod > 0.0 ? fmod( time, config.rendering.fTimeWrapPeriod ) : time;
+    double fShaderSeconds = floor( fShaderTime );
+    float fFrameDelta = (float)((nFrameTime - nLastFrameTime) / 1000000000.0);
+    nLastFrameTime = nFrameTime;
+
+    MIDI::Update();
+    Parameters::Update( fFrameDelta );
+
+    // the "seconds since" columns move every frame, so these are refreshed even without new events
+    if (texMIDI)
+    {
+      MIDI::GetStateTexture( midiState, nFrameTime );
+      Renderer::UpdateRGBA32FTexture( texMIDI, midiState );
+    }
+    if (texMIDIHistory)
+    {
+      MIDI::GetHistoryTexture( midiHistory, nFrameTime );
+      Renderer::UpdateRGBA32FTexture( texMIDIHistory, midiHistory );
+    }
 
     if (FFT::GetFFT(fftData))
     {
@@ -391,7 +763,7 @@ int main(int argc, const char *argv[])
       const static float maxIntegralValue = 1024.0f;
       for ( int i = 0; i < FFT_SIZE; i++ )
       {
-        fftDataSmoothed[i] = fftDataSmoothed[i] * fFFTSmoothingFactor + (1 - fFFTSmoothingFactor) * fftData[i];
+        fftDataSmoothed[i] = fftDataSmoothed[i] * config.rendering.fFFTSmoothFactor + (1 - config.rendering.fFFTSmoothFactor) * fftData[i];
 
         fftDataSlightlySmoothed[i] = fftDataSlightlySmoothed[i] * fFFTSlightSmoothingFactor + (1 - fFFTSlightSmoothingFactor) * fftData[i];
         fftDataIntegrated[i] = fftDataIntegrated[i] + fftDataSlightlySmoothed[i];
@@ -404,16 +776,80 @@ int main(int argc, const char *argv[])
       Renderer::UpdateR32Texture( texFFTIntegrated, fftDataIntegrated );
     }
 
-    Renderer::SetShaderTexture( "texFFT", texFFT );
-    Renderer::SetShaderTexture( "texFFTSmoothed", texFFTSmoothed );
-    Renderer::SetShaderTexture( "texFFTIntegrated", texFFTIntegrated );
+    // everything but the resolution is the same for every pass this frame
+    static const int nFFTBandEdges[5] = { 0, FFT_SIZE / 128, FFT_SIZE / 32, FFT_SIZE / 8, FFT_SIZE };
+    Renderer::FrameConstants frameConstants;
+    memset( &frameConstants, 0, sizeof(frameConstants) );
+    frameConstants.fGlobalTime = (float)fShaderTime;
+    frameConstants.fFrameTime = fFrameDelta;
+    frameConstants.v2GlobalTime[0] = (float)fShaderSeconds;
+    frameConstants.v2GlobalTime[1] = (float)(fShaderTime - fShaderSeconds);
+    frameConstants.nFrameIndex = nFrameIndex;
+    for (int i = 0; i < 4; i++)
+    {
+      float fSum = 0.0f;
+      for (int j = nFFTBandEdges[i]; j < nFFTBandEdges[i + 1]; j++)
+        fSum += fftDataSmoothed[j];
+      frameConstants.v4FFTBands[i] = fSum / (nFFTBandEdges[i + 1] - nFFTBandEdges[i]);
+    }
+    for (int i = 0; i < Parameters::GetCount(); i++)
+      frameConstants.fParameters[i] = Parameters::GetValue(i);
 
-    for (std::map<std::string, Renderer::Texture*>::iterator it = textures.begin(); it != textures.end(); it++)
+    // runs once per pipeline pass and once (twice during a transition) for the screen, each with the resolution it's rendering at
+    auto RenderShader = [&]( Renderer::Shader * shader, int nRenderWidth, int nRenderHeight, int nPass )
     {
-      Renderer::SetShaderTexture( it->first.c_str(), it->second );
+      Renderer::SetShader( shader );
+
+      frameConstants.v2Resolution[0] = (float)nRenderWidth;
+      frameConstants.v2Resolution[1] = (float)nRenderHeight;
+      if (!Renderer::SetFrameConstants( frameConstants ))
+      {
+        // a shader from before the block existed, with everything as loose uniforms
+        Renderer::SetShaderConstant( "fGlobalTime", (float)fShaderTime );
+        Renderer::SetShaderConstant( "v2GlobalTime", (float)fShaderSeconds, (float)(fShaderTime - fShaderSeconds) );
+        Renderer::SetShaderConstant( "fFrameTime", fFrameDelta );
+        Renderer::SetShaderConstant( "nFrameIndex", nFrameIndex );
+        Renderer::SetShaderConstant( "v2Resolution", nRenderWidth, nRenderHeight );
+
+        for (int i = 0; i < Parameters::GetCount(); i++)
+        {
+          Renderer::SetShaderConstant( Parameters::GetName(i), Parameters::GetValue(i) );
+        }
+      }
+
+      for (int i = 0; i < shaderTextures.size(); i++)
+      {
+        Renderer::SetShaderTexture( i, shaderTextures[i] );
+      }
+      Pipeline::SetShaderTextures( nPass, nFirstPassTexture );
+
+      Renderer::RenderFullscreenQuad();
+    };
+
+    for (int i = 0; i < Pipeline::GetPassCount(); i++)
+    {
+      Renderer::Shader * shader = tabs[ Pipeline::GetPassTab(i) ].shader;
+      if (!shader)
+        continue; // didn't compile; the buffer keeps its last contents
+      Renderer::Texture * target = Pipeline::BeginPass( i );
+      RenderShader( shader, target->width, target->height, i );
+      Pipeline::EndPass( i );
     }
+    Pipeline::EndPasses();
 
-    Renderer::RenderFullscreenQuad();
+    if (Compositor::IsRunning())
+    {
+      Renderer::Texture * target = Compositor::BeginOutgoing();
+      RenderShader( Compositor::GetOutgoingShader(), target->width, target->height, -1 );
+      target = Compositor::BeginIncoming();
+      RenderShader( pCurrentShader, target->width, target->height, -1 );
+      Compositor::Composite( time );
+    }
+    else
+    {
+      RenderShader( pCurrentShader, settings.nWidth, settings.nHeight, -1 );
+    }
+    nFrameIndex++;
 
     Renderer::StartTextRendering();
 
@@ -421,12 +857,15 @@ int main(int argc, const char *argv[])
     {
       if (time > fNextTick)
       {
-        mShaderEditor.Tick();
+        mShaderEditor->Tick();
         mDebugOutput.Tick();
         fNextTick = time + 0.1;
       }
 
-      mShaderEditor.Paint();
+      mShaderEditor->DoIdleWork( 2.0 );
+      mDebugOutput.DoIdleWork( 0.5 );
+
+      mShaderEditor->Paint();
       mDebugOutput.Paint();
 
       Renderer::SetTextRenderingViewport( Scintilla::PRectangle(0,0,Renderer::nWidth,Renderer::nHeight) );
@@ -436,26 +875,45 @@ int main(int argc, const char *argv[])
         int y1 = nMargin;
         int x1 = settings.nWidth - nMargin - nTexPreviewWidth;
         int x2 = settings.nWidth - nMargin;
-        for (std::map<std::string, Renderer::Texture*>::iterator it = textures.begin(); it != textures.end(); it++)
+        for (int i = 0; i < nConfigTextureCount; i++)
         {
-          int y2 = y1 + nTexPreviewWidth * (it->second->height / (float)it->second->width);
-          Renderer::BindTexture( it->second );
+          Renderer::Texture * tex = shaderTextures[i];
+          const std::string & sName = shaderTextureNames[i];
+          int y2 = y1 + nTexPreviewWidth * (tex->height / (float)tex->width);
+          Renderer::BindTexture( tex );
           Renderer::RenderQuad(
             Renderer::Vertex( x1, y1, 0xccFFFFFF, 0.0, 0.0 ),
             Renderer::Vertex( x2, y1, 0xccFFFFFF, 1.0, 0.0 ),
             Renderer::Vertex( x2, y2, 0xccFFFFFF, 1.0, 1.0 ),
             Renderer::Vertex( x1, y2, 0xccFFFFFF, 0.0, 1.0 )
           );
-          surface->DrawTextNoClip( Scintilla::PRectangle(x1,y1,x2,y2), *mShaderEditor.GetTextFont(), y2 - 5.0, it->first.c_str(), it->first.length(), 0xffFFFFFF, 0x00000000);
+          surface->DrawTextNoClip( Scintilla::PRectangle(x1,y1,x2,y2), *mShaderEditor->GetTextFont(), y2 - 5.0, sName.c_str(), sName.length(), 0xffFFFFFF, 0x00000000);
           y1 = y2 + nMargin;
         }
       }
 
+      if (nTabCount > 1)
+      {
+        // tabs whose program isn't compiled (anymore) are dimmed
+        float x = nMargin;
+        for (int j = 0; j < nTabCount; j++)
+        {
+          char szTab[16];
+          sprintf( szTab, j == nActiveTab ? "[%d]" : " %d ", j + 1 );
+          unsigned int nColor = j == nActiveTab ? 0xffFFFFFF : tabs[j].shader ? 0xa0FFFFFF : 0x50FFFFFF;
+          surface->DrawTextNoClip( Scintilla::PRectangle(x,0,x+100,nMargin), *mShaderEditor->GetTextFont(), nMargin - 4.0, szTab, strlen(szTab), nColor, 0x00000000);
+          x += surface->WidthText( *mShaderEditor->GetTextFont(), szTab, strlen(szTab) ) + 8;
+        }
+      }
+
       char szLayout[255];
       Misc::GetKeymapName(szLayout);
-      std::string sHelp = "F2 - toggle texture preview   F5 or Ctrl-R - recompile shader   F11 - hide GUI   Current keymap: ";
+      std::string sHelp = "F2 - toggle texture preview   F5 or Ctrl-R - recompile shader   F11 - hide GUI   ";
+      if (nTabCount > 1)
+        sHelp += "Ctrl-1..9 - switch tab   ";
+      sHelp += "Current keymap: ";
       sHelp += szLayout;
-      surface->DrawTextNoClip( Scintilla::PRectangle(20,Renderer::nHeight - 20,100,Renderer::nHeight), *mShaderEditor.GetTextFont(), Renderer::nHeight - 5.0, sHelp.c_str(), sHelp.length(), 0x80FFFFFF, 0x00000000);
+      surface->DrawTextNoClip( Scintilla::PRectangle(20,Renderer::nHeight - 20,100,Renderer::nHeight), *mShaderEditor->GetTextFont(), Renderer::nHeight - 5.0, sHelp.c_str(), sHelp.length(), 0x80FFFFFF, 0x00000000);
     }
 
 
@@ -465,14 +923,17 @@ int main(int argc, const char *argv[])
 
     Capture::CaptureFrame();
 
+    FramePacing::Tick();
+
     if (newShader)
     {
       // Frame render successful, save shader
-      FILE * f = fopen(Renderer::defaultShaderFilename,"wb");
+      FILE * f = fopen(tabs[nSavedTab].sFilename.c_str(),"wb");
       if (f)
       {
-        fwrite( szShader, strlen(szShader), 1, f );
+        fwrite( sShader.c_str(), sShader.size(), 1, f );
         fclose(f);
+        tabs[nSavedTab].sSavedText = sShader;
         mDebugOutput.SetText( "" );
       }
       else
@@ -483,23 +944,44 @@ int main(int argc, const char *argv[])
   }
 
 
+  FileWatcher::Close();
+  for (int i = 0; i < textureReloads.size(); i++)
+  {
+    textureReloads[i]->decoded.wait();
+    delete textureReloads[i];
+  }
+
+  Compositor::Close();
+  Pipeline::Close();
+  for (int i = 0; i < nTabCount; i++)
+  {
+    Renderer::ReleaseShader( tabs[i].shader );
+    delete tabs[i].editor;
+  }
   delete surface;
 
+  FramePacing::Close();
+  Capture::Close();
   MIDI::Close();
+  OSC::Close();
   FFT::Close();
 
   Renderer::ReleaseTexture( texFFT );
   Renderer::ReleaseTexture( texFFTSmoothed );
-  for (std::map<std::string, Renderer::Texture*>::iterator it = textures.begin(); it != textures.end(); it++)
+  if (texMIDI)
+    Renderer::ReleaseTexture( texMIDI );
+  if (texMIDIHistory)
+    Renderer::ReleaseTexture( texMIDIHistory );
+  for (int i = 0; i < nConfigTextureCount; i++)
   {
-    Renderer::ReleaseTexture( it->second );
+    Renderer::ReleaseTexture( shaderTextures[i] );
   }
 
   Renderer::Close();
 
-  if ( !sPostExitCmd.empty() )
+  if ( !config.sPostExitCmd.empty() )
   {
-    Misc::ExecuteCommand( sPostExitCmd.c_str(), Renderer::defaultShaderFilename );
+    Misc::ExecuteCommand( config.sPostExitCmd.c_str(), Renderer::defaultShaderFilename );
   }
 
   Misc::PlatformShutdown();
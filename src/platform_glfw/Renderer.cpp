@@ -118,11 +118,21 @@ const char * shaderBuiltin =
 namespace Renderer
 {
   const char * defaultShaderFilename = "shader.glsl";
-  const char defaultShader[65536] =
+  const char * defaultShader =
     "#version 410 core\n"
     "\n"
-    "uniform float fGlobalTime; // in seconds\n"
-    "uniform vec2 v2Resolution; // viewport resolution (in pixels)\n"
+    "layout(std140) uniform FrameConstants\n"
+    "{\n"
+    "  float fGlobalTime; // in seconds\n"
+    "  float fFrameTime; // duration of the previous frame (in seconds)\n"
+    "  vec2 v2GlobalTime; // the same split into whole seconds and fraction, for long sets\n"
+    "  vec2 v2Resolution; // viewport resolution (in pixels)\n"
+    "  int nFrameIndex; // frames rendered since startup\n"
+    "  vec4 v4FFTBands; // smoothed FFT energy: bass, low mids, high mids, treble\n"
+    "{%midi:begin%}" // leave off \n here
+    "  float {%midi:name%};\n"
+    "{%midi:end%}" // leave off \n here
+    "};\n"
     "\n"
     "uniform sampler1D texFFT; // towards 0.0 is bass / lower freq, towards 1.0 is higher / treble freq\n"
     "uniform sampler1D texFFTSmoothed; // this one has longer falloff and less harsh transients\n"
@@ -130,9 +140,8 @@ namespace Renderer
     "{%textures:begin%}" // leave off \n here
     "uniform sampler2D {%textures:name%};\n"
     "{%textures:end%}" // leave off \n here
-    "{%midi:begin%}" // leave off \n here
-    "float {%midi:name%};\n"
-    "{%midi:end%}" // leave off \n here
+    "uniform sampler2D texMIDI; // x: CC 0-127, then notes 128-255, then pitch bend at 256; y: channel 0-15; r: value, g: seconds since it changed\n"
+    "uniform sampler2D texMIDIHistory; // the last 256 events, newest at x = 0; r: seconds ago, g: message type, b: channel * 128 + CC / note, a: value\n"
     "\n"
     "layout(location = 0) out vec4 out_color; // out_color must be written in order to see anything\n"
     "\n"
@@ -161,6 +170,22 @@ namespace Renderer
     "  out_color = f + t;\n"
     "}";
 
+  const char * transitionShaderTemplate =
+    "#version 410 core\n"
+    "uniform sampler2D texFrom;\n"
+    "uniform sampler2D texTo;\n"
+    "uniform float fProgress;\n"
+    "uniform vec2 v2Resolution;\n"
+    "in vec2 out_texcoord;\n"
+    "layout(location = 0) out vec4 out_color;\n"
+    "vec4 from( vec2 uv ) { return texture( texFrom, uv ); }\n"
+    "vec4 to( vec2 uv ) { return texture( texTo, uv ); }\n"
+    "{%transition%}\n"
+    "void main()\n"
+    "{\n"
+    "  out_color = transition( out_texcoord );\n"
+    "}\n";
+
   GLFWwindow * mWindow = NULL;
   bool run = true;
 
@@ -171,6 +196,9 @@ namespace Renderer
   GLuint glhGUIVB = 0;
   GLuint glhGUIVA = 0;
   GLuint glhGUIProgram = 0;
+  GLuint glhFrameConstantsUB = 0;
+  bool bShaderHasFrameConstants = false;
+  Renderer::FrameConstants lastFrameConstants;
 
   int nWidth = 0;
   int nHeight = 0;
@@ -274,12 +302,28 @@ namespace Renderer
     printf("[GLFW] Using GLEW %s\n", glewGetString(GLEW_VERSION));
     GLenum i = glGetError(); // reset glew error
 
-    glfwSwapInterval(1);
-
-#ifdef _WIN32
-    if (settings->bVsync)
-      wglSwapIntervalEXT(1);
-#endif
+    switch (settings->framePacing)
+    {
+      case RENDERER_FRAMEPACING_UNCAPPED:
+      case RENDERER_FRAMEPACING_FIXED: // paced by FramePacing, the driver must not block on top of that
+        glfwSwapInterval(0);
+        break;
+      case RENDERER_FRAMEPACING_ADAPTIVE:
+        // a negative interval swaps late frames immediately instead of waiting for the next vblank
+        if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+        {
+          glfwSwapInterval(-1);
+          break;
+        }
+        printf("[GLFW] Adaptive vsync is not supported by the driver, falling back to vsync\n");
+        settings->framePacing = RENDERER_FRAMEPACING_VSYNC;
+        glfwSwapInterval(1);
+        break;
+      case RENDERER_FRAMEPACING_VSYNC:
+      default:
+        glfwSwapInterval(1);
+        break;
+    }
 
     // Now, since OpenGL is behaving a lot in fullscreen modes, lets collect the real obtained size!
     int fbWidth = 1;
@@ -362,9 +406,13 @@ namespace Renderer
       "out vec4 frag_color;\n"
       "void main()\n"
       "{\n"
-      "  vec4 v4Texture = out_color * texture( tex, out_texcoord );\n"
+      "  vec4 v4Sample = texture( tex, out_texcoord );\n"
+      "  float fEdgeWidth = fwidth( v4Sample.a ) * 0.7;\n"
+      "  vec4 v4Texture = out_color * v4Sample;\n"
+      "  if (out_factor < 0.0) // distance field text: the glyph edge is at 0.5\n"
+      "    v4Texture = vec4( out_color.rgb, out_color.a * smoothstep( 0.5 - fEdgeWidth, 0.5 + fEdgeWidth, v4Sample.a ) );\n"
       "  vec4 v4Color = out_color;\n"
-      "  frag_color = mix( v4Texture, v4Color, out_factor );\n"
+      "  frag_color = mix( v4Texture, v4Color, max( out_factor, 0.0 ) );\n"
       "}\n";
 
     glhGUIProgram = glCreateProgram();
@@ -409,6 +457,14 @@ namespace Renderer
 
     glGenVertexArrays(1, &glhGUIVA);
 
+    // bound to binding point 0 for good, every shader declaring the block gets pointed at it
+    glGenBuffers( 1, &glhFrameConstantsUB );
+    glBindBuffer( GL_UNIFORM_BUFFER, glhFrameConstantsUB );
+    glBufferData( GL_UNIFORM_BUFFER, sizeof(FrameConstants), NULL, GL_DYNAMIC_DRAW );
+    glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+    glBindBufferBase( GL_UNIFORM_BUFFER, 0, glhFrameConstantsUB );
+    memset( &lastFrameConstants, 0xFF, sizeof(FrameConstants) ); // NaNs, so the first upload always happens
+
     //create PBOs to hold the data. this allocates memory for them too
     glGenBuffers(2, pbo);
     glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[0]);
@@ -491,6 +547,9 @@ namespace Renderer
           if ( (key >= GLFW_KEY_A) && (key <= GLFW_KEY_Z) ) {
             sciKey = key+32;
           }
+          else if ( (key >= GLFW_KEY_0) && (key <= GLFW_KEY_9) ) {
+            sciKey = key; // same as ascii, and only reported with modifiers (tab switching)
+          }
           else {
             sciKey = 0;
           }
@@ -599,7 +658,19 @@ namespace Renderer
     glUseProgram(NULL);
   }
 
-  bool ReloadShader( const char * szShaderCode, int nShaderCodeSize, char * szErrorBuffer, int nErrorBufferSize )
+  struct GLShader : public Shader
+  {
+    GLuint program;
+    bool bFrameConstants;
+    std::vector<GLint> textureLocations; // by index into shaderTextureNames
+    int nTextureNamesVersion; // the table they were resolved against
+  };
+  GLShader * currentShader = NULL;
+
+  std::vector<std::string> shaderTextureNames;
+  int nShaderTextureNamesVersion = 0;
+
+  Shader * CompileShader( const char * szShaderCode, int nShaderCodeSize, std::string & sError )
   {
     GLuint prg = glCreateProgram();
     GLuint shd = glCreateShader(GL_FRAGMENT_SHADER);
@@ -608,33 +679,70 @@ namespace Renderer
 
     glShaderSource(shd, 1, (const GLchar**)&szShaderCode, &nShaderCodeSize);
     glCompileShader(shd);
-    glGetShaderInfoLog(shd, nErrorBufferSize, &size, szErrorBuffer);
+    glGetShaderiv(shd, GL_INFO_LOG_LENGTH, &size);
+    sError.resize( size );
+    if (size)
+      glGetShaderInfoLog(shd, size, &size, &sError[0]);
+    sError.resize( size );
     glGetShaderiv(shd, GL_COMPILE_STATUS, &result);
     if (!result)
     {
       glDeleteProgram(prg);
       glDeleteShader(shd);
-      return false;
+      return NULL;
     }
 
     glAttachShader(prg, glhVertexShader);
     glAttachShader(prg, shd);
     glLinkProgram(prg);
-    glGetProgramInfoLog(prg, nErrorBufferSize - size, &size, szErrorBuffer + size);
+    size_t nCompileLogSize = sError.size();
+    glGetProgramiv(prg, GL_INFO_LOG_LENGTH, &size);
+    sError.resize( nCompileLogSize + size );
+    if (size)
+      glGetProgramInfoLog(prg, size, &size, &sError[ nCompileLogSize ]);
+    sError.resize( nCompileLogSize + size );
     glGetProgramiv(prg, GL_LINK_STATUS, &result);
+    glDeleteShader(shd); // only flagged; it goes away with the program
     if (!result)
     {
       glDeleteProgram(prg);
-      glDeleteShader(shd);
-      return false;
+      return NULL;
     }
 
-    if (theShader)
-      glDeleteProgram(theShader);
+    GLShader * shader = new GLShader();
+    shader->program = prg;
+    shader->nTextureNamesVersion = -1;
+    GLuint nBlockIndex = glGetUniformBlockIndex( prg, "FrameConstants" );
+    shader->bFrameConstants = nBlockIndex != GL_INVALID_INDEX;
+    if (shader->bFrameConstants)
+      glUniformBlockBinding( prg, nBlockIndex, 0 );
+    return shader;
+  }
 
-    theShader = prg;
+  void SetShader( Shader * shader )
+  {
+    currentShader = (GLShader*)shader;
+    theShader = shader ? ((GLShader*)shader)->program : 0;
+    bShaderHasFrameConstants = shader ? ((GLShader*)shader)->bFrameConstants : false;
+  }
 
-    return true;
+  void ReleaseShader( Shader * shader )
+  {
+    if (!shader)
+      return;
+    if (theShader == ((GLShader*)shader)->program)
+      SetShader( NULL );
+    glDeleteProgram( ((GLShader*)shader)->program );
+    delete (GLShader*)shader;
+  }
+
+  void SetShaderConstant( const char * szConstName, int x )
+  {
+    GLint location = glGetUniformLocation( theShader, szConstName );
+    if ( location != -1 )
+    {
+      glProgramUniform1i( theShader, location, x );
+    }
   }
 
   void SetShaderConstant( const char * szConstName, float x )
@@ -655,13 +763,41 @@ namespace Renderer
     }
   }
 
+  bool SetFrameConstants( const FrameConstants & constants )
+  {
+    if (!bShaderHasFrameConstants)
+      return false;
+    if (memcmp( &constants, &lastFrameConstants, sizeof(FrameConstants) ) != 0)
+    {
+      glBindBuffer( GL_UNIFORM_BUFFER, glhFrameConstantsUB );
+      glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof(FrameConstants), &constants );
+      glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+      lastFrameConstants = constants;
+    }
+    return true;
+  }
+
   struct GLTexture : public Texture
   {
     GLuint ID;
     int unit;
+    bool bSharedUnit; // the GUI textures all sit on unit 0 instead of one of their own
+    GLuint framebuffer; // render targets only
   };
 
+  // every texture keeps a unit for its lifetime; released units are handed out
+  // again, so textures that keep getting reloaded don't run out of them
   int textureUnit = 0;
+  std::vector<int> freeTextureUnits;
+  int AllocateTextureUnit()
+  {
+    if (freeTextureUnits.empty())
+      return textureUnit++;
+    int unit = freeTextureUnits.back();
+    freeTextureUnits.pop_back();
+    return unit;
+  }
+
   Texture * CreateRGBA8TextureFromFile( const char * szFilename )
   {
     int comp = 0;
@@ -691,7 +827,52 @@ namespace Renderer
     tex->height = height;
     tex->ID = glTexId;
     tex->type = TEXTURETYPE_2D;
-    tex->unit = textureUnit++;
+    tex->unit = AllocateTextureUnit();
+    return tex;
+  }
+
+  Texture * CreateTextureFromMipLevels( TEXTUREFORMAT format, const MipLevel * levels, int nLevels )
+  {
+    if (format != TEXTUREFORMAT_RGBA8 && !GLEW_EXT_texture_compression_s3tc)
+    {
+      printf("[GLFW] S3TC texture compression isn't supported\n");
+      return NULL;
+    }
+
+    GLuint glTexId = 0;
+    glGenTextures( 1, &glTexId );
+    glBindTexture( GL_TEXTURE_2D, glTexId );
+
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, nLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, nLevels - 1 );
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    for (int i = 0; i < nLevels; i++)
+    {
+      switch (format)
+      {
+        case TEXTUREFORMAT_RGBA8:
+          glTexImage2D( GL_TEXTURE_2D, i, GL_SRGB8_ALPHA8, levels[i].width, levels[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[i].data );
+          break;
+        case TEXTUREFORMAT_BC1:
+          glCompressedTexImage2D( GL_TEXTURE_2D, i, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, levels[i].width, levels[i].height, 0, (GLsizei)levels[i].size, levels[i].data );
+          break;
+        case TEXTUREFORMAT_BC3:
+          glCompressedTexImage2D( GL_TEXTURE_2D, i, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, levels[i].width, levels[i].height, 0, (GLsizei)levels[i].size, levels[i].data );
+          break;
+      }
+    }
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+    GLTexture * tex = new GLTexture();
+    tex->width = levels[0].width;
+    tex->height = levels[0].height;
+    tex->ID = glTexId;
+    tex->type = TEXTURETYPE_2D;
+    tex->unit = AllocateTextureUnit();
     return tex;
   }
 
@@ -720,10 +901,21 @@ namespace Renderer
     tex->height = 1;
     tex->ID = glTexId;
     tex->type = TEXTURETYPE_1D;
-    tex->unit = textureUnit++;
+    tex->unit = AllocateTextureUnit();
     return tex;
   }
 
+  void BindShaderTexture( GLint location, Texture * tex )
+  {
+    glProgramUniform1i( theShader, location, ((GLTexture*)tex)->unit );
+    glActiveTexture( GL_TEXTURE0 + ((GLTexture*)tex)->unit );
+    switch( tex->type)
+    {
+      case TEXTURETYPE_1D: glBindTexture( GL_TEXTURE_1D, ((GLTexture*)tex)->ID ); break;
+      case TEXTURETYPE_2D: glBindTexture( GL_TEXTURE_2D, ((GLTexture*)tex)->ID ); break;
+    }
+  }
+
   void SetShaderTexture( const char * szTextureName, Texture * tex )
   {
     if (!tex)
@@ -732,13 +924,33 @@ namespace Renderer
     GLint location = glGetUniformLocation( theShader, szTextureName );
     if ( location != -1 )
     {
-      glProgramUniform1i( theShader, location, ((GLTexture*)tex)->unit );
-      glActiveTexture( GL_TEXTURE0 + ((GLTexture*)tex)->unit );
-      switch( tex->type)
-      {
-        case TEXTURETYPE_1D: glBindTexture( GL_TEXTURE_1D, ((GLTexture*)tex)->ID ); break;
-        case TEXTURETYPE_2D: glBindTexture( GL_TEXTURE_2D, ((GLTexture*)tex)->ID ); break;
-      }
+      BindShaderTexture( location, tex );
+    }
+  }
+
+  void SetShaderTextureNames( const std::vector<std::string> & names )
+  {
+    shaderTextureNames = names;
+    nShaderTextureNamesVersion++;
+  }
+
+  void SetShaderTexture( int nName, Texture * tex )
+  {
+    if (!tex || !currentShader || nName < 0 || nName >= shaderTextureNames.size())
+      return;
+
+    if (currentShader->nTextureNamesVersion != nShaderTextureNamesVersion)
+    {
+      currentShader->textureLocations.resize( shaderTextureNames.size() );
+      for (int i = 0; i < shaderTextureNames.size(); i++)
+        currentShader->textureLocations[i] = glGetUniformLocation( currentShader->program, shaderTextureNames[i].c_str() );
+      currentShader->nTextureNamesVersion = nShaderTextureNamesVersion;
+    }
+
+    GLint location = currentShader->textureLocations[ nName ];
+    if ( location != -1 )
+    {
+      BindShaderTexture( location, tex );
     }
   }
 
@@ -751,8 +963,49 @@ namespace Renderer
     return true;
   }
 
-  Texture * CreateA8TextureFromData( int w, int h, const unsigned char * data )
+  Texture * CreateRGBA32FTexture( int w, int h )
   {
+    GLuint glTexId = 0;
+    glGenTextures( 1, &glTexId );
+    glBindTexture( GL_TEXTURE_2D, glTexId );
+
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+
+    float * data = new float[w * h * 4];
+    memset( data, 0, sizeof(float) * w * h * 4 );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA32F, w, h, 0, GL_RGBA, GL_FLOAT, data );
+    delete[] data;
+
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    GLTexture * tex = new GLTexture();
+    tex->width = w;
+    tex->height = h;
+    tex->ID = glTexId;
+    tex->type = TEXTURETYPE_2D;
+    tex->unit = AllocateTextureUnit();
+    return tex;
+  }
+
+  bool UpdateRGBA32FTexture( Texture * tex, const float * data )
+  {
+    glActiveTexture( GL_TEXTURE0 + ((GLTexture*)tex)->unit );
+    glBindTexture( GL_TEXTURE_2D, ((GLTexture*)tex)->ID );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, tex->width, tex->height, GL_RGBA, GL_FLOAT, data );
+
+    return true;
+  }
+
+  Texture * CreateA8TextureFromData( int w, int h, const unsigned char * data, bool distanceField )
+  {
+    // new glyph pages get made in the middle of text rendering, so leave the GUI's binding alone
+    GLint nPreviousTexture = 0;
+    glActiveTexture( GL_TEXTURE0 );
+    glGetIntegerv( GL_TEXTURE_BINDING_2D, &nPreviousTexture );
+
     GLuint glTexId = 0;
     glGenTextures(1, &glTexId);
     glBindTexture(GL_TEXTURE_2D, glTexId);
@@ -762,6 +1015,7 @@ namespace Renderer
     delete[] p32bitData;
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture( GL_TEXTURE_2D, nPreviousTexture );
 
     GLTexture * tex = new GLTexture();
     tex->width = w;
@@ -769,12 +1023,94 @@ namespace Renderer
     tex->ID = glTexId;
     tex->type = TEXTURETYPE_2D;
     tex->unit = 0; // this is always 0 cos we're not using shaders here
+    tex->bSharedUnit = true;
+    tex->distanceField = distanceField;
     return tex;
   }
 
+  bool UpdateA8TextureRegion( Texture * tex, int x, int y, int w, int h, const unsigned char * data )
+  {
+    // this can happen in the middle of text rendering, so leave the GUI's binding alone
+    GLint nPreviousTexture = 0;
+    glActiveTexture( GL_TEXTURE0 + ((GLTexture*)tex)->unit );
+    glGetIntegerv( GL_TEXTURE_BINDING_2D, &nPreviousTexture );
+    glBindTexture( GL_TEXTURE_2D, ((GLTexture*)tex)->ID );
+
+    unsigned int * p32bitData = new unsigned int[ w * h ];
+    for(int i=0; i<w*h; i++) p32bitData[i] = (data[i] << 24) | 0xFFFFFF;
+    glTexSubImage2D( GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, p32bitData );
+    delete[] p32bitData;
+
+    glBindTexture( GL_TEXTURE_2D, nPreviousTexture );
+    return true;
+  }
+
   void ReleaseTexture( Texture * tex )
   {
+    if (((GLTexture*)tex)->framebuffer)
+      glDeleteFramebuffers(1, &((GLTexture*)tex)->framebuffer );
     glDeleteTextures(1, &((GLTexture*)tex)->ID );
+    if (!((GLTexture*)tex)->bSharedUnit)
+      freeTextureUnits.push_back( ((GLTexture*)tex)->unit );
+    delete (GLTexture*)tex;
+  }
+
+  Texture * CreateRenderTarget( int w, int h, RENDERTARGETFORMAT format )
+  {
+    GLint internalFormat = GL_RGBA8;
+    GLenum type = GL_UNSIGNED_BYTE;
+    switch (format)
+    {
+      case RENDERTARGETFORMAT_RGBA16F: internalFormat = GL_RGBA16F; type = GL_HALF_FLOAT; break;
+      case RENDERTARGETFORMAT_RGBA32F: internalFormat = GL_RGBA32F; type = GL_FLOAT; break;
+    }
+
+    GLuint glTexId = 0;
+    glGenTextures( 1, &glTexId );
+    glBindTexture( GL_TEXTURE_2D, glTexId );
+    glTexImage2D( GL_TEXTURE_2D, 0, internalFormat, w, h, 0, GL_RGBA, type, NULL );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    GLuint glFramebuffer = 0;
+    glGenFramebuffers( 1, &glFramebuffer );
+    glBindFramebuffer( GL_FRAMEBUFFER, glFramebuffer );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, glTexId, 0 );
+    GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+      printf("[GLFW] Render target %d x %d is incomplete (0x%04X)\n", w, h, status);
+      glDeleteFramebuffers( 1, &glFramebuffer );
+      glDeleteTextures( 1, &glTexId );
+      return NULL;
+    }
+
+    GLTexture * tex = new GLTexture();
+    tex->width = w;
+    tex->height = h;
+    tex->ID = glTexId;
+    tex->type = TEXTURETYPE_2D;
+    tex->unit = AllocateTextureUnit();
+    tex->framebuffer = glFramebuffer;
+    return tex;
+  }
+
+  void SetRenderTarget( Texture * target )
+  {
+    if (target)
+    {
+      glBindFramebuffer( GL_FRAMEBUFFER, ((GLTexture*)target)->framebuffer );
+      glViewport( 0, 0, target->width, target->height );
+    }
+    else
+    {
+      glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+      glViewport( 0, 0, nWidth, nHeight );
+    }
   }
 
   //////////////////////////////////////////////////////////////////////////
@@ -842,7 +1178,7 @@ namespace Renderer
     *(unsigned int *)(f++) = v.c;
     *(f++) = v.u;
     *(f++) = v.v;
-    *(f++) = lastTexture ? 0.0f : 1.0f;
+    *(f++) = lastTexture ? (lastTexture->distanceField ? -1.0f : 0.0f) : 1.0f;
     bufferPointer++;
   }
   void BindTexture( Texture * tex )
@@ -2,11 +2,16 @@
 #include <windows.h>
 #include <mmsystem.h>
 #include <tchar.h>
+#include "../MIDI.h"
+#include "../Timer.h"
 
 namespace MIDI
 {
-  int nCCValues[256];
-  void CALLBACK MyMidiInProc( HMIDIIN hMidiIn, UINT wMsg, DWORD dwInstance, DWORD dwParam1, DWORD dwParam2) 
+  HMIDIIN hMIDIInput[32];
+  EventQueue queues[32]; // the driver may call back on a different thread per device, so one queue each
+  int nMIDIDeviceCount = 0;
+
+  void CALLBACK MyMidiInProc( HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2) 
   {
     switch (wMsg) {
     case MM_MIM_OPEN:
@@ -20,23 +25,25 @@ namespace MIDI
     case MM_MIM_DATA:
       {
         unsigned char nMIDIMessage = dwParam1 & 0xFF;
-        unsigned char nMIDIMessageType = nMIDIMessage >> 4;
-        unsigned char nMIDIChannel = nMIDIMessage & 0x0F;
-        unsigned char nMIDIControl = (dwParam1 >> 8) & 0xFF;
-        unsigned char nMIDIValue = (dwParam1 >> 16) & 0xFF;
 
-        //printf("[%08X] MM_MIM_DATA - TYPE: %X CHAN: %3d CTRL: %3d VAL: %3d\n",hMidiIn,nMIDIMessageType,nMIDIChannel,nMIDIControl,nMIDIValue);
-        nCCValues[ nMIDIControl ] = nMIDIValue;
+        Event e;
+        e.nTime = Timer::GetTimeNS();
+        e.nType = nMIDIMessage >> 4;
+        e.nChannel = nMIDIMessage & 0x0F;
+        e.nData1 = (dwParam1 >> 8) & 0xFF;
+        e.nData2 = (dwParam1 >> 16) & 0xFF;
+
+        //printf("[%08X] MM_MIM_DATA - TYPE: %X CHAN: %3d CTRL: %3d VAL: %3d\n",hMidiIn,e.nType,e.nChannel,e.nData1,e.nData2);
+        queues[ dwInstance ].Push( e );
       } break;
     }
   }
 
-  HMIDIIN hMIDIInput[32];
-  int nMIDIDeviceCount = 0;
   bool Open()
   {
-    ZeroMemory( &nCCValues, sizeof(int) * 256 );
     nMIDIDeviceCount = midiInGetNumDevs();
+    if (nMIDIDeviceCount > 32)
+      nMIDIDeviceCount = 32;
 
     for (int i = 0; i < nMIDIDeviceCount; i++) 
     {
@@ -44,7 +51,8 @@ namespace MIDI
       midiInGetDevCaps(i,&caps,sizeof(MIDIINCAPS));
       //_tprintf(_T("%d - %d - %d - %08X - %s\n"),i,caps.wMid,caps.wPid,caps.vDriverVersion,caps.szPname);
 
-      midiInOpen(&hMIDIInput[i],i,(DWORD_PTR)MyMidiInProc,NULL,CALLBACK_FUNCTION);
+      AddQueue( &queues[i] );
+      midiInOpen(&hMIDIInput[i],i,(DWORD_PTR)MyMidiInProc,(DWORD_PTR)i,CALLBACK_FUNCTION);
 
       midiInStart(hMIDIInput[i]);
     }
@@ -57,12 +65,7 @@ namespace MIDI
       midiInStop(hMIDIInput[i]);
       midiInClose(hMIDIInput[i]);
     }
+    RemoveQueues();
     return true;
   }
-
-  float GetCCValue( unsigned char cc )
-  {
-    return nCCValues[cc] / 127.0f;
-  }
-
-};
\ No newline at end of file
+};
@@ -65,6 +65,48 @@ namespace Misc
     return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES;
   }
 
+  const void * MapFile(const char * path, size_t & size)
+  {
+    HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+      return NULL;
+
+    const void * data = NULL;
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(hFile, &fileSize) && fileSize.QuadPart > 0)
+    {
+      HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (hMapping)
+      {
+        size = (size_t)fileSize.QuadPart;
+        data = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(hMapping); // the view keeps the mapping alive
+      }
+    }
+    CloseHandle(hFile);
+    return data;
+  }
+
+  void UnmapFile(const void * data, size_t size)
+  {
+    UnmapViewOfFile(data);
+  }
+
+  bool GetFileStamp(const char * path, unsigned long long & size, unsigned long long & modified)
+  {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+      return false;
+    size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    modified = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+  }
+
+  bool MakeDirectory(const char * path)
+  {
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+  }
+
   const char * GetDefaultFontPath()
   {
     const char* fontPaths[] = 
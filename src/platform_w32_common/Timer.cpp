@@ -2,32 +2,30 @@
 
 namespace Timer
 {
-  LARGE_INTEGER LastPCV = { 0 } ;
-  double currentTime = 0.0;
+  LARGE_INTEGER startPCV = { 0 };
+  LARGE_INTEGER freq = { 0 };
 
-  double _Time()
+  void Start()
   {
-    LARGE_INTEGER count, freq;
-    if (!LastPCV.QuadPart) {
-      QueryPerformanceCounter(&LastPCV);
-    }
-    QueryPerformanceCounter(&count);
     QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&startPCV);
+  }
 
-    currentTime += (double)(count.QuadPart - LastPCV.QuadPart) / (double)(freq.QuadPart);
+  unsigned long long GetTimeNS()
+  {
+    if (!freq.QuadPart)
+      QueryPerformanceFrequency(&freq);
 
-    LastPCV=count;
+    LARGE_INTEGER count;
+    QueryPerformanceCounter(&count);
 
-    return currentTime * 1000.0f;
+    // split to avoid overflowing 64 bits with ticks * 1e9
+    unsigned long long ticks = count.QuadPart - startPCV.QuadPart;
+    return (ticks / freq.QuadPart) * 1000000000ull + (ticks % freq.QuadPart) * 1000000000ull / freq.QuadPart;
   }
 
-  float startTime = 0.0;
-  void Start()
-  {
-    startTime = (float)_Time();
-  }
-  float GetTime()
+  double GetTime()
   {
-    return (float)_Time() - startTime;
+    return GetTimeNS() / 1000000.0;
   }
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #include <windowsx.h>
 #include <tchar.h>
 #include <float.h>
+#include <vector>
 
 #include <d3d11.h>
 #include <D3Dcompiler.h>
@@ -101,19 +102,25 @@ const char * shaderBuiltin =
 namespace Renderer
 {
   const char * defaultShaderFilename = "shader.dx11.hlsl";
-  const char defaultShader[65536] =
+  const char * defaultShader =
     "{%textures:begin%}" // leave off \n here
     "Texture2D {%textures:name%};\n"
     "{%textures:end%}" // leave off \n here
     "Texture1D texFFT; // towards 0.0 is bass / lower freq, towards 1.0 is higher / treble freq\n"
     "Texture1D texFFTSmoothed; // this one has longer falloff and less harsh transients\n"
     "Texture1D texFFTIntegrated; // this is continually increasing\n"
+    "Texture2D texMIDI; // x: CC 0-127, then notes 128-255, then pitch bend at 256; y: channel 0-15; r: value, g: seconds since it changed\n"
+    "Texture2D texMIDIHistory; // the last 256 events, newest at x = 0; r: seconds ago, g: message type, b: channel * 128 + CC / note, a: value\n"
     "SamplerState smp;\n"
     "\n"
-    "cbuffer constants\n"
+    "cbuffer FrameConstants : register(b1)\n"
     "{\n"
     "  float fGlobalTime; // in seconds\n"
+    "  float fFrameTime; // duration of the previous frame (in seconds)\n"
+    "  float2 v2GlobalTime; // the same split into whole seconds and fraction, for long sets\n"
     "  float2 v2Resolution; // viewport resolution (in pixels)\n"
+    "  int nFrameIndex; // frames rendered since startup\n"
+    "  float4 v4FFTBands; // smoothed FFT energy: bass, low mids, high mids, treble\n"
     "{%midi:begin%}"
     "  float {%midi:name%};\n"
     "{%midi:end%}"
@@ -144,7 +151,7 @@ namespace Renderer
     "  return f + t;\n"
     "}";
 
-  char defaultVertexShader[65536] = 
+  const char * defaultVertexShader = 
     "struct VS_INPUT_PP { float3 Pos : POSITION; float2 TexCoord : TEXCOORD; };\n"
     "struct VS_OUTPUT_PP { float4 Pos : SV_POSITION; float2 TexCoord : TEXCOORD; };\n"
     "\n"
@@ -158,6 +165,31 @@ namespace Renderer
 
   bool run = true;
 
+  const char * transitionShaderTemplate =
+    "Texture2D texFrom;\n"
+    "Texture2D texTo;\n"
+    "SamplerState smp;\n"
+    "\n"
+    "cbuffer constants\n"
+    "{\n"
+    "  float fProgress;\n"
+    "  float2 v2Resolution;\n"
+    "}\n"
+    "\n"
+    "// the transitions are shared with the GLSL renderer\n"
+    "#define vec2 float2\n"
+    "#define vec3 float3\n"
+    "#define vec4 float4\n"
+    "#define mix lerp\n"
+    "#define fract frac\n"
+    "float4 from( float2 uv ) { return texFrom.Sample( smp, uv ); }\n"
+    "float4 to( float2 uv ) { return texTo.Sample( smp, uv ); }\n"
+    "{%transition%}\n"
+    "float4 main( float4 position : SV_POSITION, float2 TexCoord : TEXCOORD ) : SV_TARGET\n"
+    "{\n"
+    "  return transition( float2( TexCoord.x, 1.0 - TexCoord.y ) );\n"
+    "}\n";
+
   IDXGISwapChain * pSwapChain = NULL;
   ID3D11Device * pDevice = NULL;
   ID3D11DeviceContext * pContext = NULL;
@@ -360,7 +392,9 @@ namespace Renderer
     return true;
   }
 
-  bool bVsync = false;
+  RENDERER_FRAMEPACING framePacing = RENDERER_FRAMEPACING_UNCAPPED;
+  LONGLONG nRefreshPeriodTicks = 0; // in QueryPerformanceCounter ticks, for adaptive vsync
+  LONGLONG nLastPresentTicks = 0;
   bool InitDirect3D(RENDERER_SETTINGS * pSetup) 
   {
     DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -371,9 +405,9 @@ namespace Renderer
     desc.BufferDesc.Width = pSetup->nWidth;
     desc.BufferDesc.Height = pSetup->nHeight;
     desc.BufferDesc.Format = format;
-    if (pSetup->bVsync)
+    framePacing = pSetup->framePacing;
+    if (framePacing == RENDERER_FRAMEPACING_VSYNC || framePacing == RENDERER_FRAMEPACING_ADAPTIVE)
     {
-      bVsync = true;
       IDXGIFactory1 * pFactory = NULL;
       HRESULT hr = CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&pFactory);
       if (pFactory)
@@ -411,6 +445,17 @@ namespace Renderer
         pFactory->Release();
       }
     }
+    if (framePacing == RENDERER_FRAMEPACING_ADAPTIVE)
+    {
+      // no tearing control before DXGI 1.5, so adaptive is done by hand:
+      // a frame that already missed its refresh is presented without waiting for the next one
+      double fRefreshRate = 60.0;
+      if (desc.BufferDesc.RefreshRate.Numerator && desc.BufferDesc.RefreshRate.Denominator)
+        fRefreshRate = desc.BufferDesc.RefreshRate.Numerator / (double)desc.BufferDesc.RefreshRate.Denominator;
+      LARGE_INTEGER freq;
+      QueryPerformanceFrequency(&freq);
+      nRefreshPeriodTicks = (LONGLONG)(freq.QuadPart / fRefreshRate);
+    }
     desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
     desc.OutputWindow = hWnd;
     desc.SampleDesc.Count = 1;
@@ -463,6 +508,8 @@ namespace Renderer
   ID3D11InputLayout * pFullscreenQuadLayout = NULL;
   ID3D11SamplerState * pFullscreenQuadSamplerState = NULL;
   ID3D11Buffer * pFullscreenQuadConstantBuffer = NULL;
+  ID3D11Buffer * pFrameConstantBuffer = NULL; // b1, next to the loose constants in b0
+  Renderer::FrameConstants lastFrameConstants;
 #define FULLSCREENQUADCONSTANTS_SIZE 512
   unsigned char pFullscreenQuadConstants[FULLSCREENQUADCONSTANTS_SIZE];
   ID3D11BlendState* pFullscreenQuadBlendState = NULL;
@@ -540,7 +587,7 @@ namespace Renderer
     sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-    sampDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
+    sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
     if (pDevice->CreateSamplerState( &sampDesc, &pFullscreenQuadSamplerState ) != S_OK)
       return false;
 
@@ -559,6 +606,11 @@ namespace Renderer
     if (pDevice->CreateBuffer( &cbDesc, &subData, &pFullscreenQuadConstantBuffer ) != S_OK)
       return false;
 
+    cbDesc.ByteWidth = (sizeof(FrameConstants) + 15) & ~15;
+    if (pDevice->CreateBuffer( &cbDesc, NULL, &pFrameConstantBuffer ) != S_OK)
+      return false;
+    memset( &lastFrameConstants, 0xFF, sizeof(FrameConstants) ); // so the first upload always happens
+
     //////////////////////////////////////////////////////////////////////////
 
     D3D11_BLEND_DESC blendDesc = CD3D11_BLEND_DESC( CD3D11_DEFAULT() );
@@ -574,16 +626,20 @@ namespace Renderer
 
 #define GUIQUADVB_SIZE (1024 * 6)
 
-  char defaultGUIPixelShader[65536] = 
+  const char * defaultGUIPixelShader = 
     "Texture2D tex;\n"
     "SamplerState smp;\n"
     "float4 main( float4 position : SV_POSITION, float4 Color: COLOR, float2 TexCoord : TEXCOORD0, float Factor : TEXCOORD1 ) : SV_TARGET\n"
     "{\n"
-    "  float4 v4Texture = Color * tex.Sample(smp,TexCoord);//float4( Color.rgb, Color.a * .a );\n"
+    "  float4 v4Sample = tex.Sample(smp,TexCoord);\n"
+    "  float fEdgeWidth = fwidth( v4Sample.a ) * 0.7;\n"
+    "  float4 v4Texture = Color * v4Sample;\n"
+    "  if (Factor < 0.0) // distance field text: the glyph edge is at 0.5\n"
+    "    v4Texture = float4( Color.rgb, Color.a * smoothstep( 0.5 - fEdgeWidth, 0.5 + fEdgeWidth, v4Sample.a ) );\n"
     "  float4 v4Color = Color;\n"
-    "  return lerp( v4Texture, v4Color, Factor );\n"
+    "  return lerp( v4Texture, v4Color, max( Factor, 0.0 ) );\n"
     "}\n";
-  char defaultGUIVertexShader[65536] = 
+  const char * defaultGUIVertexShader = 
     "struct VS_INPUT_PP { float3 Pos : POSITION; float4 Color: COLOR; float2 TexCoord : TEXCOORD0; float Factor : TEXCOORD1; };\n"
     "struct VS_OUTPUT_PP { float4 Pos : SV_POSITION; float4 Color: COLOR; float2 TexCoord : TEXCOORD0; float Factor : TEXCOORD1; };\n"
     "\n"
@@ -757,7 +813,20 @@ namespace Renderer
   }
   void EndFrame()
   {
-    pSwapChain->Present( bVsync ? 1 : 0, NULL );
+    UINT nSyncInterval = 0;
+    if (framePacing == RENDERER_FRAMEPACING_VSYNC)
+    {
+      nSyncInterval = 1;
+    }
+    else if (framePacing == RENDERER_FRAMEPACING_ADAPTIVE)
+    {
+      LARGE_INTEGER count;
+      QueryPerformanceCounter(&count);
+      // a quarter period of slack so regular vsynced frames don't get misread as late
+      nSyncInterval = (count.QuadPart - nLastPresentTicks > nRefreshPeriodTicks + nRefreshPeriodTicks / 4) ? 0 : 1;
+      nLastPresentTicks = count.QuadPart;
+    }
+    pSwapChain->Present( nSyncInterval, NULL );
   }
   bool WantsToQuit()
   {
@@ -767,14 +836,13 @@ namespace Renderer
   {
     // TODO: a bunch of other crap needs to be deallocated here but i cant be arsed
 
-    if (theShader) theShader->Release();
-    if (pShaderReflection) pShaderReflection->Release();
     if (pVertexShader) pVertexShader->Release();
 
     if (pFullscreenQuadLayout) pFullscreenQuadLayout->Release();
     if (pFullscreenQuadVB) pFullscreenQuadVB->Release();
     if (pFullscreenQuadSamplerState) pFullscreenQuadSamplerState->Release();
     if (pFullscreenQuadConstantBuffer) pFullscreenQuadConstantBuffer->Release();
+    if (pFrameConstantBuffer) pFrameConstantBuffer->Release();
     if (pFullscreenQuadBlendState) pFullscreenQuadBlendState->Release();
     if (pFullscreenQuadRasterizerState) pFullscreenQuadRasterizerState->Release();
 
@@ -797,6 +865,15 @@ namespace Renderer
     }
   }
 
+  bool bConstantsDirty = false; // uploaded once before the draw, not after every SetShaderConstant()
+  void __UpdateConstants()
+  {
+    D3D11_MAPPED_SUBRESOURCE subRes;
+    pContext->Map( pFullscreenQuadConstantBuffer, NULL, D3D11_MAP_WRITE_DISCARD, NULL, &subRes );
+    CopyMemory( subRes.pData, &pFullscreenQuadConstants, sizeof(pFullscreenQuadConstants) );
+    pContext->Unmap( pFullscreenQuadConstantBuffer, NULL );
+  }
+
   void RenderFullscreenQuad()
   {
     float factor[4] = { 1.0f, 1.0f, 1.0f, 1.0f, };
@@ -804,7 +881,13 @@ namespace Renderer
     pContext->PSSetShader( theShader, NULL, NULL );
     pContext->IASetInputLayout( pFullscreenQuadLayout );
     pContext->PSSetSamplers( 0, 1, &pFullscreenQuadSamplerState );
-    pContext->PSSetConstantBuffers( 0, 1, &pFullscreenQuadConstantBuffer );
+    if (bConstantsDirty)
+    {
+      __UpdateConstants();
+      bConstantsDirty = false;
+    }
+    ID3D11Buffer * constantBuffers[] = { pFullscreenQuadConstantBuffer, pFrameConstantBuffer };
+    pContext->PSSetConstantBuffers( 0, 2, constantBuffers );
     pContext->OMSetBlendState( pFullscreenQuadBlendState, factor, 0xFFFFFFFF );
     pContext->RSSetState( pFullscreenQuadRasterizerState );
 
@@ -819,43 +902,93 @@ namespace Renderer
   }
 
   ID3D11ShaderReflectionConstantBuffer * pCBuf = NULL;
-  bool ReloadShader( const char * szShaderCode, int nShaderCodeSize, char * szErrorBuffer, int nErrorBufferSize )
+
+  struct DX11Shader : public Shader
+  {
+    ID3D11PixelShader * pPixelShader;
+    ID3D11ShaderReflection * pReflection;
+    std::vector<int> textureSlots; // by index into shaderTextureNames, -1 where unused
+    int nTextureNamesVersion; // the table they were resolved against
+  };
+  DX11Shader * currentShader = NULL;
+
+  std::vector<std::string> shaderTextureNames;
+  int nShaderTextureNamesVersion = 0;
+
+  Shader * CompileShader( const char * szShaderCode, int nShaderCodeSize, std::string & sError )
   {
     ID3DBlob * pCode = NULL;
     ID3DBlob * pErrors = NULL;
     if (D3DCompile( szShaderCode, nShaderCodeSize, NULL, NULL, NULL, "main", "ps_4_0", NULL, NULL, &pCode, &pErrors ) != S_OK)
     {
-      memset( szErrorBuffer, 0, nErrorBufferSize );
-      strncpy( szErrorBuffer, (const char*)pErrors->GetBufferPointer(), nErrorBufferSize - 1 );
-      return false;
+      sError.clear();
+      if (pErrors)
+      {
+        sError.assign( (const char*)pErrors->GetBufferPointer(), pErrors->GetBufferSize() );
+        sError.resize( strlen( sError.c_str() ) ); // the blob counts its terminator
+        pErrors->Release();
+      }
+      return NULL;
     }
+    if (pErrors)
+      pErrors->Release();
 
-    if (theShader) 
+    ID3D11PixelShader * pPixelShader = NULL;
+    if (pDevice->CreatePixelShader( pCode->GetBufferPointer(), pCode->GetBufferSize(), NULL, &pPixelShader ) != S_OK)
     {
-      theShader->Release();
-      theShader = NULL;
+      pCode->Release();
+      return NULL;
     }
 
-    if (pDevice->CreatePixelShader( pCode->GetBufferPointer(), pCode->GetBufferSize(), NULL, &theShader ) != S_OK)
-    {
-      return false;
-    }
-    D3DReflect( pCode->GetBufferPointer(), pCode->GetBufferSize(), IID_ID3D11ShaderReflection, (void**)&pShaderReflection );
-    pCBuf = pShaderReflection->GetConstantBufferByIndex(0);
+    DX11Shader * shader = new DX11Shader();
+    shader->pPixelShader = pPixelShader;
+    shader->pReflection = NULL;
+    shader->nTextureNamesVersion = -1;
+    D3DReflect( pCode->GetBufferPointer(), pCode->GetBufferSize(), IID_ID3D11ShaderReflection, (void**)&shader->pReflection );
+    pCode->Release();
+    return shader;
+  }
 
-    return true;
+  void SetShader( Shader * shader )
+  {
+    DX11Shader * pShader = (DX11Shader *)shader;
+    currentShader = pShader;
+    theShader = pShader ? pShader->pPixelShader : NULL;
+    pShaderReflection = pShader ? pShader->pReflection : NULL;
+    pCBuf = pShaderReflection ? pShaderReflection->GetConstantBufferByIndex(0) : NULL;
   }
 
-  void __UpdateConstants()
+  void ReleaseShader( Shader * shader )
   {
-    D3D11_MAPPED_SUBRESOURCE subRes;
-    pContext->Map( pFullscreenQuadConstantBuffer, NULL, D3D11_MAP_WRITE_DISCARD, NULL, &subRes );
-    CopyMemory( subRes.pData, &pFullscreenQuadConstants, sizeof(pFullscreenQuadConstants) );
-    pContext->Unmap( pFullscreenQuadConstantBuffer, NULL );
+    DX11Shader * pShader = (DX11Shader *)shader;
+    if (!pShader)
+      return;
+    if (theShader == pShader->pPixelShader)
+      SetShader( NULL );
+    pShader->pPixelShader->Release();
+    if (pShader->pReflection)
+      pShader->pReflection->Release();
+    delete pShader;
+  }
+
+  void SetShaderConstant( const char * szConstName, int x )
+  {
+    if (!pCBuf)
+      return;
+    ID3D11ShaderReflectionVariable * pCVar = pCBuf->GetVariableByName( szConstName );
+    D3D11_SHADER_VARIABLE_DESC pDesc;
+    if (pCVar->GetDesc( &pDesc ) != S_OK)
+      return;
+
+    ((int*)(((unsigned char*)&pFullscreenQuadConstants) + pDesc.StartOffset))[0] = x;
+
+    bConstantsDirty = true;
   }
 
   void SetShaderConstant( const char * szConstName, float x )
   {
+    if (!pCBuf)
+      return;
     ID3D11ShaderReflectionVariable * pCVar = pCBuf->GetVariableByName( szConstName );
     D3D11_SHADER_VARIABLE_DESC pDesc;
     if (pCVar->GetDesc( &pDesc ) != S_OK)
@@ -863,11 +996,13 @@ namespace Renderer
     
     ((float*)(((unsigned char*)&pFullscreenQuadConstants) + pDesc.StartOffset))[0] = x;
 
-    __UpdateConstants();
+    bConstantsDirty = true;
   }
 
   void SetShaderConstant( const char * szConstName, float x, float y )
   {
+    if (!pCBuf)
+      return;
     ID3D11ShaderReflectionVariable * pCVar = pCBuf->GetVariableByName(szConstName);
     D3D11_SHADER_VARIABLE_DESC pDesc;
     if (pCVar->GetDesc( &pDesc ) != S_OK)
@@ -876,7 +1011,25 @@ namespace Renderer
     ((float*)(((unsigned char*)&pFullscreenQuadConstants) + pDesc.StartOffset))[0] = x;
     ((float*)(((unsigned char*)&pFullscreenQuadConstants) + pDesc.StartOffset))[1] = y;
 
-    __UpdateConstants();
+    bConstantsDirty = true;
+  }
+
+  bool SetFrameConstants( const FrameConstants & constants )
+  {
+    D3D11_SHADER_BUFFER_DESC desc;
+    if (!pShaderReflection || pShaderReflection->GetConstantBufferByName( "FrameConstants" )->GetDesc( &desc ) != S_OK)
+      return false;
+
+    if (memcmp( &constants, &lastFrameConstants, sizeof(FrameConstants) ) != 0)
+    {
+      D3D11_MAPPED_SUBRESOURCE subRes;
+      if (pContext->Map( pFrameConstantBuffer, NULL, D3D11_MAP_WRITE_DISCARD, NULL, &subRes ) != S_OK)
+        return true;
+      CopyMemory( subRes.pData, &constants, sizeof(FrameConstants) );
+      pContext->Unmap( pFrameConstantBuffer, NULL );
+      lastFrameConstants = constants;
+    }
+    return true;
   }
 
   struct DX11Texture : public Texture
@@ -884,6 +1037,7 @@ namespace Renderer
     ID3D11Resource * pTexture;
     DXGI_FORMAT format;
     ID3D11ShaderResourceView * pResourceView;
+    ID3D11RenderTargetView * pRenderTargetView; // render targets only
   };
 
   void CreateResourceView( DX11Texture * tex )
@@ -901,7 +1055,7 @@ namespace Renderer
     {
       desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
       desc.Texture2D.MostDetailedMip = 0;
-      desc.Texture2D.MipLevels = 1;
+      desc.Texture2D.MipLevels = (UINT)-1; // all of them
     }
     pDevice->CreateShaderResourceView( tex->pTexture, &desc, &tex->pResourceView );
   }
@@ -947,6 +1101,44 @@ namespace Renderer
     return tex;
   }
 
+  Texture * CreateTextureFromMipLevels( TEXTUREFORMAT format, const MipLevel * levels, int nLevels )
+  {
+    DXGI_FORMAT formats[] = { DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, DXGI_FORMAT_BC1_UNORM_SRGB, DXGI_FORMAT_BC3_UNORM_SRGB };
+    int blockBytes[] = { 0, 8, 16 };
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc,sizeof(D3D11_TEXTURE2D_DESC));
+    desc.Width = levels[0].width;
+    desc.Height = levels[0].height;
+    desc.Format = formats[ format ];
+    desc.MipLevels = nLevels;
+    desc.ArraySize = 1;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    std::vector<D3D11_SUBRESOURCE_DATA> subData( nLevels );
+    for (int i = 0; i < nLevels; i++)
+    {
+      subData[i].pSysMem = levels[i].data;
+      subData[i].SysMemPitch = format == TEXTUREFORMAT_RGBA8 ? levels[i].width * 4 : ((levels[i].width + 3) / 4) * blockBytes[ format ];
+      subData[i].SysMemSlicePitch = 0;
+    }
+
+    ID3D11Texture2D * pTex = NULL;
+    if (pDevice->CreateTexture2D( &desc, &subData[0], &pTex ) != S_OK)
+      return NULL;
+
+    DX11Texture * tex = new DX11Texture();
+    tex->width = levels[0].width;
+    tex->height = levels[0].height;
+    tex->pTexture = pTex;
+    tex->type = TEXTURETYPE_2D;
+    tex->format = desc.Format;
+    CreateResourceView(tex);
+    return tex;
+  }
+
   Texture * Create1DR32Texture( int w )
   {
     D3D11_TEXTURE1D_DESC desc;
@@ -976,14 +1168,48 @@ namespace Renderer
 
   void SetShaderTexture( const char * szTextureName, Texture * tex )
   {
+    if (!tex)
+      return;
+
     D3D11_SHADER_INPUT_BIND_DESC desc;
-    if (pShaderReflection->GetResourceBindingDescByName( szTextureName, &desc ) == S_OK)
+    if (pShaderReflection && pShaderReflection->GetResourceBindingDescByName( szTextureName, &desc ) == S_OK)
     {
       DX11Texture * pTex = (DX11Texture *) tex;
       pContext->PSSetShaderResources( desc.BindPoint, 1, &pTex->pResourceView );
     }
   }
 
+  void SetShaderTextureNames( const std::vector<std::string> & names )
+  {
+    shaderTextureNames = names;
+    nShaderTextureNamesVersion++;
+  }
+
+  void SetShaderTexture( int nName, Texture * tex )
+  {
+    if (!tex || !currentShader || nName < 0 || nName >= shaderTextureNames.size())
+      return;
+
+    if (currentShader->nTextureNamesVersion != nShaderTextureNamesVersion)
+    {
+      currentShader->textureSlots.resize( shaderTextureNames.size() );
+      for (int i = 0; i < shaderTextureNames.size(); i++)
+      {
+        D3D11_SHADER_INPUT_BIND_DESC desc;
+        bool bFound = currentShader->pReflection && currentShader->pReflection->GetResourceBindingDescByName( shaderTextureNames[i].c_str(), &desc ) == S_OK;
+        currentShader->textureSlots[i] = bFound ? (int)desc.BindPoint : -1;
+      }
+      currentShader->nTextureNamesVersion = nShaderTextureNamesVersion;
+    }
+
+    int nSlot = currentShader->textureSlots[ nName ];
+    if (nSlot >= 0)
+    {
+      DX11Texture * pTex = (DX11Texture *) tex;
+      pContext->PSSetShaderResources( nSlot, 1, &pTex->pResourceView );
+    }
+  }
+
   bool UpdateR32Texture( Texture * tex, float * data )
   {
     ID3D11Texture1D * pTex = (ID3D11Texture1D *) ((DX11Texture *) tex)->pTexture;
@@ -995,7 +1221,49 @@ namespace Renderer
     return true;
   }
 
-  Texture * CreateA8TextureFromData( int w, int h, const unsigned char * data )
+  Texture * CreateRGBA32FTexture( int w, int h )
+  {
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc,sizeof(D3D11_TEXTURE2D_DESC));
+    desc.Width = w;
+    desc.Height = h;
+    desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    ID3D11Texture2D * pTex = NULL;
+
+    if (pDevice->CreateTexture2D( &desc, NULL, &pTex ) != S_OK)
+      return NULL;
+
+    DX11Texture * tex = new DX11Texture();
+    tex->width = w;
+    tex->height = h;
+    tex->pTexture = pTex;
+    tex->type = TEXTURETYPE_2D;
+    tex->format = desc.Format;
+    CreateResourceView(tex);
+    return tex;
+  }
+
+  bool UpdateRGBA32FTexture( Texture * tex, const float * data )
+  {
+    ID3D11Texture2D * pTex = (ID3D11Texture2D *) ((DX11Texture *) tex)->pTexture;
+
+    D3D11_MAPPED_SUBRESOURCE subRes;
+    if (pContext->Map( pTex, NULL, D3D11_MAP_WRITE_DISCARD, NULL, &subRes ) != S_OK)
+      return false;
+    for (int y = 0; y < tex->height; y++)
+      CopyMemory( (unsigned char *)subRes.pData + y * subRes.RowPitch, data + y * tex->width * 4, sizeof(float) * 4 * tex->width );
+    pContext->Unmap( pTex, NULL );
+    return true;
+  }
+
+  Texture * CreateA8TextureFromData( int w, int h, const unsigned char * data, bool distanceField )
   {
     D3D11_TEXTURE2D_DESC desc;
     ZeroMemory(&desc,sizeof(D3D11_TEXTURE2D_DESC));
@@ -1028,17 +1296,89 @@ namespace Renderer
     tex->pTexture = pTex;
     tex->type = TEXTURETYPE_2D;
     tex->format = desc.Format;
+    tex->distanceField = distanceField;
     CreateResourceView(tex);
     return tex;
   }
 
+  bool UpdateA8TextureRegion( Texture * tex, int x, int y, int w, int h, const unsigned char * data )
+  {
+    unsigned int * p = new unsigned int[ w * h ];
+    for (int i=0; i < w * h; i++)
+      p[i] = (data[i] << 24) | 0xFFFFFF;
+
+    D3D11_BOX box;
+    box.left = x;
+    box.top = y;
+    box.front = 0;
+    box.right = x + w;
+    box.bottom = y + h;
+    box.back = 1;
+    pContext->UpdateSubresource( ((DX11Texture *)tex)->pTexture, 0, &box, p, w * sizeof(unsigned int), 0 );
+
+    delete[] p;
+    return true;
+  }
+
   void ReleaseTexture( Texture * tex )
   {
+    if (((DX11Texture *)tex)->pRenderTargetView)
+      ((DX11Texture *)tex)->pRenderTargetView->Release();
     ((DX11Texture *)tex)->pResourceView->Release();
     ((DX11Texture *)tex)->pTexture->Release();
     delete tex;
   }
 
+  Texture * CreateRenderTarget( int w, int h, RENDERTARGETFORMAT format )
+  {
+    DXGI_FORMAT formats[] = { DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT };
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory( &desc, sizeof(D3D11_TEXTURE2D_DESC) );
+    desc.Width = w;
+    desc.Height = h;
+    desc.Format = formats[ format ];
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+    ID3D11Texture2D * pTex = NULL;
+    if (pDevice->CreateTexture2D( &desc, NULL, &pTex ) != S_OK)
+    {
+      printf("[Renderer] Cannot create %d x %d render target\n", w, h);
+      return NULL;
+    }
+
+    DX11Texture * tex = new DX11Texture();
+    tex->width = w;
+    tex->height = h;
+    tex->pTexture = pTex;
+    tex->type = TEXTURETYPE_2D;
+    tex->format = desc.Format;
+    CreateResourceView( tex );
+    pDevice->CreateRenderTargetView( pTex, NULL, &tex->pRenderTargetView );
+    return tex;
+  }
+
+  void SetRenderTarget( Texture * target )
+  {
+    // a texture can't be a target while it's still bound as a shader input from a previous pass
+    ID3D11ShaderResourceView * pNullViews[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = { NULL };
+    pContext->PSSetShaderResources( 0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, pNullViews );
+
+    D3D11_VIEWPORT viewport;
+    ZeroMemory( &viewport, sizeof(D3D11_VIEWPORT) );
+    viewport.Width = target ? target->width : nWidth;
+    viewport.Height = target ? target->height : nHeight;
+    viewport.MaxDepth = 1.0f;
+
+    ID3D11RenderTargetView * pView = target ? ((DX11Texture *)target)->pRenderTargetView : pRenderTarget;
+    pContext->OMSetRenderTargets( 1, &pView, NULL );
+    pContext->RSSetViewports( 1, &viewport );
+  }
+
   //////////////////////////////////////////////////////////////////////////
   // text rendering
 
@@ -1107,7 +1447,7 @@ namespace Renderer
     *(unsigned int *)(f++) = v.c;
     *(f++) = v.u;
     *(f++) = v.v;
-    *(f++) = lastTexture ? 0.0f : 1.0f;
+    *(f++) = lastTexture ? (lastTexture->distanceField ? -1.0f : 0.0f) : 1.0f;
     bufferPointer++;
   }
   void BindTexture( Texture * tex )
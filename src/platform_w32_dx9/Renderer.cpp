@@ -109,23 +109,32 @@ const char * shaderBuiltin =
 namespace Renderer
 {
   const char * defaultShaderFilename = "shader.dx9.hlsl";
-  const char defaultShader[65536] = 
+  const char * defaultShader = 
     "texture texTFFT; sampler1D texFFT = sampler_state { Texture = <texTFFT>; }; \n"
     "// towards 0.0 is bass / lower freq, towards 1.0 is higher / treble freq\n"
     "texture texFFTSmoothedT; sampler1D texFFTSmoothed = sampler_state { Texture = <texFFTSmoothedT>; }; \n"
     "// this one has longer falloff and less harsh transients\n"
     "texture texFFTIntegratedT; sampler1D texFFTIntegrated = sampler_state { Texture = <texFFTIntegratedT>; }; \n"
     "// this is continually increasing\n"
+    "texture texMIDIT; sampler2D texMIDI = sampler_state { Texture = <texMIDIT>; }; \n"
+    "// x: CC 0-127, then notes 128-255, then pitch bend at 256; y: channel 0-15; r: value, g: seconds since it changed\n"
+    "texture texMIDIHistoryT; sampler2D texMIDIHistory = sampler_state { Texture = <texMIDIHistoryT>; }; \n"
+    "// the last 256 events, newest at x = 0; r: seconds ago, g: message type, b: channel * 128 + CC / note, a: value\n"
     "\n"
     "{%textures:begin%}" // leave off \n here
     "texture raw{%textures:name%}; sampler2D {%textures:name%} = sampler_state { Texture = <raw{%textures:name%}>; };\n"
     "{%textures:end%}"
     "\n"
+    "float4 frameConstants[19] : register(c0); // everything below, written in one go every frame\n"
+    "#define fGlobalTime frameConstants[0].x // in seconds\n"
+    "#define fFrameTime frameConstants[0].y // duration of the previous frame (in seconds)\n"
+    "#define v2GlobalTime frameConstants[0].zw // the same split into whole seconds and fraction, for long sets\n"
+    "#define v2Resolution frameConstants[1].xy // viewport resolution (in pixels)\n"
+    "#define nFrameIndex ((int)frameConstants[1].z) // frames rendered since startup\n"
+    "#define v4FFTBands frameConstants[2] // smoothed FFT energy: bass, low mids, high mids, treble\n"
     "{%midi:begin%}" // leave off \n here
-    "float {%midi:name%};\n"
+    "#define {%midi:name%} frameConstants[3 + {%midi:index%} / 4][{%midi:index%} % 4]\n"
     "{%midi:end%}"
-    "float fGlobalTime; // in seconds\n"
-    "float2 v2Resolution; // viewport resolution (in pixels)\n"
     "\n"
     "float4 plas( float2 v, float time )\n"
     "{\n"
@@ -151,7 +160,27 @@ namespace Renderer
     "  t = saturate( t );\n"
     "  return f + t;\n"
     "}";
-  char defaultVertexShader[65536] = 
+  const char * transitionShaderTemplate =
+    "texture texFromT; sampler2D texFrom = sampler_state { Texture = <texFromT>; };\n"
+    "texture texToT; sampler2D texTo = sampler_state { Texture = <texToT>; };\n"
+    "float fProgress;\n"
+    "float2 v2Resolution;\n"
+    "\n"
+    "// the transitions are shared with the GLSL renderer\n"
+    "#define vec2 float2\n"
+    "#define vec3 float3\n"
+    "#define vec4 float4\n"
+    "#define mix lerp\n"
+    "#define fract frac\n"
+    "float4 from( float2 uv ) { return tex2D( texFrom, uv ); }\n"
+    "float4 to( float2 uv ) { return tex2D( texTo, uv ); }\n"
+    "{%transition%}\n"
+    "float4 main( float2 TexCoord : TEXCOORD0 ) : COLOR0\n"
+    "{\n"
+    "  // flipped to texture space, and the half texel D3D9 puts between pixel and texel centers\n"
+    "  return transition( float2( TexCoord.x, 1.0 - TexCoord.y ) + 0.5 / v2Resolution );\n"
+    "}\n";
+  const char * defaultVertexShader = 
     "struct VS_INPUT_PP { float3 Pos : POSITION0; float2 TexCoord : TEXCOORD0; };\n"
     "struct VS_OUTPUT_PP { float4 Pos : POSITION0; float2 TexCoord : TEXCOORD0; };\n"
     "\n"
@@ -168,6 +197,7 @@ namespace Renderer
   LPDIRECT3D9 pD3D = NULL;
   LPDIRECT3DDEVICE9 pDevice = NULL;
   LPD3DXCONSTANTTABLE pConstantTable = NULL;
+  bool bShaderHasFrameConstants = false;
   LPDIRECT3DVERTEXSHADER9 pVertexShader = NULL;
   LPDIRECT3DPIXELSHADER9 theShader = NULL;
   LPDIRECT3DSURFACE9 pBackBuffer = NULL;
@@ -383,7 +413,13 @@ namespace Renderer
     d3dpp.SwapEffect     = D3DSWAPEFFECT_DISCARD;
     d3dpp.hDeviceWindow  = hWnd;
     d3dpp.Windowed       = pSetup->windowMode != RENDERER_WINDOWMODE_FULLSCREEN;
-    d3dpp.PresentationInterval = pSetup->bVsync ? D3DPRESENT_INTERVAL_ONE : D3DPRESENT_INTERVAL_IMMEDIATE;
+    if (pSetup->framePacing == RENDERER_FRAMEPACING_ADAPTIVE)
+    {
+      // D3D9 fixes the interval at device creation, so there's no way to let only the late frames through
+      printf("[Renderer] Adaptive vsync is not supported by D3D9, falling back to vsync\n");
+      pSetup->framePacing = RENDERER_FRAMEPACING_VSYNC;
+    }
+    d3dpp.PresentationInterval = pSetup->framePacing == RENDERER_FRAMEPACING_VSYNC ? D3DPRESENT_INTERVAL_ONE : D3DPRESENT_INTERVAL_IMMEDIATE;
 
     d3dpp.BackBufferCount  = 1;
 
@@ -444,7 +480,7 @@ namespace Renderer
     {
       pDevice->SetSamplerState( x, D3DSAMP_MINFILTER, D3DTEXF_LINEAR);
       pDevice->SetSamplerState( x, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR);
-      pDevice->SetSamplerState( x, D3DSAMP_MIPFILTER, D3DTEXF_NONE);
+      pDevice->SetSamplerState( x, D3DSAMP_MIPFILTER, D3DTEXF_LINEAR);
     }
 
     pDevice->GetRenderTarget( 0, &pBackBuffer );
@@ -553,7 +589,6 @@ namespace Renderer
     if (pFullscreenQuadVertexDecl) pFullscreenQuadVertexDecl->Release();
     if (pGUIQuadVB) pGUIQuadVB->Release();
     if (pVertexShader) pVertexShader->Release();
-    if (theShader) theShader->Release();
     if (pDevice) pDevice->Release();
     if (pD3D) pD3D->Release();
     if (!hWnd) 
@@ -575,35 +610,87 @@ namespace Renderer
     pDevice->DrawPrimitive( D3DPT_TRIANGLESTRIP, 0, 2 );
   }
 
-  bool ReloadShader( const char * szShaderCode, int nShaderCodeSize, char * szErrorBuffer, int nErrorBufferSize )
+  struct DX9Shader : public Shader
+  {
+    LPDIRECT3DPIXELSHADER9 pPixelShader;
+    LPD3DXCONSTANTTABLE pConstantTable;
+    bool bFrameConstants;
+    std::vector<int> samplerIndices; // by index into shaderTextureNames, -1 where unused
+    int nTextureNamesVersion; // the table they were resolved against
+  };
+  DX9Shader * currentShader = NULL;
+
+  std::vector<std::string> shaderTextureNames;
+  int nShaderTextureNamesVersion = 0;
+
+  Shader * CompileShader( const char * szShaderCode, int nShaderCodeSize, std::string & sError )
   {
     LPD3DXBUFFER pShader = NULL;
     LPD3DXBUFFER pErrors = NULL;
+    LPD3DXCONSTANTTABLE pTable = NULL;
 
-    if (D3DXCompileShader( szShaderCode, nShaderCodeSize, NULL, NULL, "main", "ps_3_0", NULL, &pShader, &pErrors, &pConstantTable ) != D3D_OK)
+    if (D3DXCompileShader( szShaderCode, nShaderCodeSize, NULL, NULL, "main", "ps_3_0", NULL, &pShader, &pErrors, &pTable ) != D3D_OK)
     {
-      memset( szErrorBuffer, 0, nErrorBufferSize );
-      strncpy( szErrorBuffer, (const char*)pErrors->GetBufferPointer(), nErrorBufferSize - 1 );
-      return false;
+      sError.clear();
+      if (pErrors)
+      {
+        sError.assign( (const char*)pErrors->GetBufferPointer(), pErrors->GetBufferSize() );
+        sError.resize( strlen( sError.c_str() ) ); // the blob counts its terminator
+        pErrors->Release();
+      }
+      return NULL;
     }
+    if (pErrors)
+      pErrors->Release();
 
-    if (theShader) 
+    LPDIRECT3DPIXELSHADER9 pPixelShader = NULL;
+    HRESULT h = pDevice->CreatePixelShader( (DWORD*)pShader->GetBufferPointer(), &pPixelShader );
+    pShader->Release();
+    if (h != D3D_OK)
     {
-      theShader->Release();
-      theShader = NULL;
+      pTable->Release();
+      return NULL;
     }
 
-    if (pDevice->CreatePixelShader( (DWORD*)pShader->GetBufferPointer(), &theShader ) != D3D_OK)
-    {
-      return false;
-    }
+    DX9Shader * shader = new DX9Shader();
+    shader->pPixelShader = pPixelShader;
+    shader->pConstantTable = pTable;
+    shader->nTextureNamesVersion = -1;
+    shader->bFrameConstants = pTable->GetConstantByName( NULL, "frameConstants" ) != NULL;
+    return shader;
+  }
 
-    return true;
+  void SetShader( Shader * shader )
+  {
+    DX9Shader * pShader = (DX9Shader *)shader;
+    currentShader = pShader;
+    theShader = pShader ? pShader->pPixelShader : NULL;
+    pConstantTable = pShader ? pShader->pConstantTable : NULL;
+    bShaderHasFrameConstants = pShader ? pShader->bFrameConstants : false;
+  }
+
+  void ReleaseShader( Shader * shader )
+  {
+    DX9Shader * pShader = (DX9Shader *)shader;
+    if (!pShader)
+      return;
+    if (theShader == pShader->pPixelShader)
+      SetShader( NULL );
+    pShader->pPixelShader->Release();
+    pShader->pConstantTable->Release();
+    delete pShader;
+  }
+
+  void SetShaderConstant( const char * szConstName, int x )
+  {
+    if (pConstantTable)
+      pConstantTable->SetInt( pDevice, szConstName, x );
   }
 
   void SetShaderConstant( const char * szConstName, float x )
   {
-    pConstantTable->SetFloat( pDevice, szConstName, x );
+    if (pConstantTable)
+      pConstantTable->SetFloat( pDevice, szConstName, x );
   }
 
   static D3DXVECTOR4 SetShaderConstant_VEC4;
@@ -613,12 +700,30 @@ namespace Renderer
     SetShaderConstant_VEC4.y = y;
     SetShaderConstant_VEC4.z = 0;
     SetShaderConstant_VEC4.w = 0;
-    pConstantTable->SetVector( pDevice, szConstName, &SetShaderConstant_VEC4 );
+    if (pConstantTable)
+      pConstantTable->SetVector( pDevice, szConstName, &SetShaderConstant_VEC4 );
+  }
+
+  // unlike the GL / DX11 buffers, the registers are shared with the loose
+  // constants of other shaders (the transitions), so they're always rewritten
+  static_assert( sizeof(FrameConstants) == 19 * sizeof(float) * 4, "frameConstants[] in the default shader needs to match" );
+  bool SetFrameConstants( const FrameConstants & constants )
+  {
+    if (!bShaderHasFrameConstants)
+      return false;
+
+    FrameConstants registers = constants;
+    float fFrameIndex = (float)constants.nFrameIndex; // the block only lives in float registers
+    memcpy( &registers.nFrameIndex, &fFrameIndex, sizeof(float) );
+    pDevice->SetPixelShaderConstantF( 0, (const float *)&registers, sizeof(FrameConstants) / (sizeof(float) * 4) );
+    return true;
   }
 
   struct DX9Texture : public Texture
   {
     LPDIRECT3DTEXTURE9 pTexture;
+    bool renderTarget; // already holds gamma encoded output, so sampled without the sRGB conversion
+    bool dataTexture; // raw values fetched texel by texel: no sRGB conversion, no filtering
   };
 
   int textureUnit = 0;
@@ -653,6 +758,57 @@ namespace Renderer
     return tex;
   }
 
+  Texture * CreateTextureFromMipLevels( TEXTUREFORMAT format, const MipLevel * levels, int nLevels )
+  {
+    D3DFORMAT formats[] = { D3DFMT_A8R8G8B8, D3DFMT_DXT1, D3DFMT_DXT5 };
+    int blockBytes[] = { 0, 8, 16 };
+
+    LPDIRECT3DTEXTURE9 pTex = NULL;
+    if (pDevice->CreateTexture( levels[0].width, levels[0].height, nLevels, 0, formats[ format ], D3DPOOL_MANAGED, &pTex, NULL ) != D3D_OK)
+      return NULL;
+
+    for (int i = 0; i < nLevels; i++)
+    {
+      D3DLOCKED_RECT rect;
+      if (pTex->LockRect( i, &rect, NULL, 0 ) != D3D_OK)
+      {
+        pTex->Release();
+        return NULL;
+      }
+
+      const unsigned char * src = levels[i].data;
+      unsigned char * dst = (unsigned char *)rect.pBits;
+      if (format == TEXTUREFORMAT_RGBA8)
+      {
+        // D3DFMT_A8R8G8B8 is BGRA in memory
+        for (int y = 0; y < levels[i].height; y++, dst += rect.Pitch)
+        {
+          for (int x = 0; x < levels[i].width; x++, src += 4)
+          {
+            dst[x * 4 + 0] = src[2];
+            dst[x * 4 + 1] = src[1];
+            dst[x * 4 + 2] = src[0];
+            dst[x * 4 + 3] = src[3];
+          }
+        }
+      }
+      else
+      {
+        int rowBytes = ((levels[i].width + 3) / 4) * blockBytes[ format ];
+        for (int y = 0; y < (levels[i].height + 3) / 4; y++, dst += rect.Pitch, src += rowBytes)
+          memcpy( dst, src, rowBytes );
+      }
+      pTex->UnlockRect( i );
+    }
+
+    DX9Texture * tex = new DX9Texture();
+    tex->pTexture = pTex;
+    tex->width = levels[0].width;
+    tex->height = levels[0].height;
+    tex->type = TEXTURETYPE_2D;
+    return tex;
+  }
+
   Texture * Create1DR32Texture( int w )
   {
     LPDIRECT3DTEXTURE9 pTex = NULL;
@@ -674,16 +830,79 @@ namespace Renderer
     return tex;
   }
 
+  void BindShaderTexture( int idx, Texture * tex )
+  {
+    DX9Texture * dxTex = (DX9Texture *)tex;
+    pDevice->SetSamplerState( idx, D3DSAMP_SRGBTEXTURE, (dxTex->renderTarget || dxTex->dataTexture) ? FALSE : TRUE );
+    pDevice->SetSamplerState( idx, D3DSAMP_MINFILTER, dxTex->dataTexture ? D3DTEXF_POINT : D3DTEXF_LINEAR );
+    pDevice->SetSamplerState( idx, D3DSAMP_MAGFILTER, dxTex->dataTexture ? D3DTEXF_POINT : D3DTEXF_LINEAR );
+    pDevice->SetSamplerState( idx, D3DSAMP_ADDRESSU, dxTex->dataTexture ? D3DTADDRESS_CLAMP : D3DTADDRESS_WRAP );
+    pDevice->SetSamplerState( idx, D3DSAMP_ADDRESSV, dxTex->dataTexture ? D3DTADDRESS_CLAMP : D3DTADDRESS_WRAP );
+    pDevice->SetTexture( idx, dxTex->pTexture );
+  }
+
   void SetShaderTexture( const char * szTextureName, Texture * tex )
   {
+    if (!pConstantTable || !tex)
+      return;
     int idx = pConstantTable->GetSamplerIndex( szTextureName );
     if (idx >= 0)
+      BindShaderTexture( idx, tex );
+  }
+
+  void SetShaderTextureNames( const std::vector<std::string> & names )
+  {
+    shaderTextureNames = names;
+    nShaderTextureNamesVersion++;
+  }
+
+  void SetShaderTexture( int nName, Texture * tex )
+  {
+    if (!tex || !currentShader || nName < 0 || nName >= shaderTextureNames.size())
+      return;
+
+    if (currentShader->nTextureNamesVersion != nShaderTextureNamesVersion)
     {
-      pDevice->SetSamplerState( idx, D3DSAMP_SRGBTEXTURE, TRUE );
-      pDevice->SetSamplerState( idx, D3DSAMP_ADDRESSU, D3DTADDRESS_WRAP );
-      pDevice->SetSamplerState( idx, D3DSAMP_ADDRESSV, D3DTADDRESS_WRAP );
-      pDevice->SetTexture( idx, ((DX9Texture *)tex)->pTexture );
+      currentShader->samplerIndices.resize( shaderTextureNames.size() );
+      for (int i = 0; i < shaderTextureNames.size(); i++)
+        currentShader->samplerIndices[i] = currentShader->pConstantTable->GetSamplerIndex( shaderTextureNames[i].c_str() );
+      currentShader->nTextureNamesVersion = nShaderTextureNamesVersion;
     }
+
+    int idx = currentShader->samplerIndices[ nName ];
+    if (idx >= 0)
+      BindShaderTexture( idx, tex );
+  }
+
+  Texture * CreateRGBA32FTexture( int w, int h )
+  {
+    LPDIRECT3DTEXTURE9 pTex = NULL;
+    pDevice->CreateTexture( w, h, 1, D3DUSAGE_DYNAMIC, D3DFMT_A32B32G32R32F, D3DPOOL_DEFAULT, &pTex, NULL );
+
+    if (!pTex)
+      return NULL;
+
+    DX9Texture * tex = new DX9Texture();
+    tex->pTexture = pTex;
+    tex->width = w;
+    tex->height = h;
+    tex->type = TEXTURETYPE_2D;
+    tex->dataTexture = true;
+    return tex;
+  }
+
+  bool UpdateRGBA32FTexture( Texture * tex, const float * data )
+  {
+    LPDIRECT3DTEXTURE9 pTex = ((DX9Texture *)tex)->pTexture;
+
+    D3DLOCKED_RECT rect;
+    if (pTex->LockRect( 0, &rect, NULL, D3DLOCK_DISCARD ) != D3D_OK)
+      return false;
+    for (int y = 0; y < tex->height; y++)
+      memcpy( (unsigned char *)rect.pBits + y * rect.Pitch, data + y * tex->width * 4, tex->width * sizeof(float) * 4 );
+    pTex->UnlockRect(0);
+
+    return true;
   }
 
   bool UpdateR32Texture( Texture * tex, float * data )
@@ -698,7 +917,7 @@ namespace Renderer
     return true;
   }
 
-  Texture * CreateA8TextureFromData( int w, int h, const unsigned char * data )
+  Texture * CreateA8TextureFromData( int w, int h, const unsigned char * data, bool distanceField )
   {
     LPDIRECT3DTEXTURE9 pTex = NULL;
     pDevice->CreateTexture( w, h, 0, NULL, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &pTex, NULL );
@@ -730,12 +949,35 @@ namespace Renderer
     tex->width = w;
     tex->height = h;
     tex->type = TEXTURETYPE_1D;
+    tex->distanceField = distanceField;
     return tex;
   }
 
+  bool UpdateA8TextureRegion( Texture * tex, int x, int y, int w, int h, const unsigned char * data )
+  {
+    RECT region = { x, y, x + w, y + h };
+    D3DLOCKED_RECT rect;
+    if (((DX9Texture *)tex)->pTexture->LockRect( 0, &rect, &region, NULL ) != D3D_OK)
+      return false;
+
+    const unsigned char * src = data;
+    unsigned char * dst = (unsigned char *)rect.pBits;
+    for (int i=0; i<h; i++)
+    {
+      unsigned int * dstLine = (unsigned int *)dst;
+      for (int j=0; j<w; j++)
+        dstLine[j] = (src[j] << 24) | 0xFFFFFF;
+      src += w;
+      dst += rect.Pitch;
+    }
+    ((DX9Texture *)tex)->pTexture->UnlockRect(0);
+    return true;
+  }
+
   //////////////////////////////////////////////////////////////////////////
   // text rendering
 
+  Texture * lastTexture = NULL;
 
   void StartTextRendering()
   {
@@ -761,6 +1003,10 @@ namespace Renderer
     pDevice->SetTextureStageState( 0, D3DTSS_ALPHAOP, D3DTOP_MODULATE );
     pDevice->SetTextureStageState( 0, D3DTSS_ALPHAARG1, D3DTA_DIFFUSE );
     pDevice->SetTextureStageState( 0, D3DTSS_ALPHAARG2, D3DTA_TEXTURE );
+
+    pDevice->SetRenderState( D3DRS_ALPHAREF, 0x80 );
+    pDevice->SetRenderState( D3DRS_ALPHAFUNC, D3DCMP_GREATEREQUAL );
+    pDevice->SetRenderState( D3DRS_ALPHATESTENABLE, (lastTexture && lastTexture->distanceField) ? TRUE : FALSE );
   }
 
   void ReleaseTexture( Texture * tex )
@@ -769,6 +1015,41 @@ namespace Renderer
     delete tex;
   }
 
+  Texture * CreateRenderTarget( int w, int h, RENDERTARGETFORMAT format )
+  {
+    D3DFORMAT formats[] = { D3DFMT_A8R8G8B8, D3DFMT_A16B16G16R16F, D3DFMT_A32B32G32R32F };
+
+    LPDIRECT3DTEXTURE9 pTex = NULL;
+    if (pDevice->CreateTexture( w, h, 1, D3DUSAGE_RENDERTARGET, formats[ format ], D3DPOOL_DEFAULT, &pTex, NULL ) != D3D_OK)
+    {
+      printf("[Renderer] Cannot create %d x %d render target\n", w, h);
+      return NULL;
+    }
+
+    DX9Texture * tex = new DX9Texture();
+    tex->pTexture = pTex;
+    tex->width = w;
+    tex->height = h;
+    tex->type = TEXTURETYPE_2D;
+    tex->renderTarget = true;
+    return tex;
+  }
+
+  void SetRenderTarget( Texture * target )
+  {
+    // SetRenderTarget() also resets the viewport to the whole surface
+    if (!target)
+    {
+      pDevice->SetRenderTarget( 0, pBackBuffer );
+      return;
+    }
+
+    LPDIRECT3DSURFACE9 pSurface = NULL;
+    ((DX9Texture *)target)->pTexture->GetSurfaceLevel( 0, &pSurface );
+    pDevice->SetRenderTarget( 0, pSurface );
+    pSurface->Release();
+  }
+
   int bufferPointer = 0;
   unsigned char buffer[GUIQUADVB_SIZE * sizeof(float) * 6];
   bool lastModeIsQuad = true;
@@ -794,7 +1075,6 @@ namespace Renderer
   {
     return (abgr&0xff00ff00)+((abgr<<16)&0x00ff0000)+((abgr>>16)&0x000000ff);
   }
-  Texture * lastTexture = NULL;
   void __WriteVertexToBuffer( const Vertex & v )
   {
     if (bufferPointer >= GUIQUADVB_SIZE)
@@ -818,6 +1098,9 @@ namespace Renderer
       __FlushRenderCache();
       lastTexture = tex;
       pDevice->SetTexture( 0, tex ? ((DX9Texture *)tex)->pTexture : NULL );
+
+      // no GUI shader here, so distance field text is alpha tested instead of smoothed
+      pDevice->SetRenderState( D3DRS_ALPHATESTENABLE, (tex && tex->distanceField) ? TRUE : FALSE );
     }
   }
 
@@ -864,6 +1147,7 @@ namespace Renderer
     __FlushRenderCache();
     pDevice->SetRenderState( D3DRS_SCISSORTESTENABLE, false );
     pDevice->SetRenderState( D3DRS_ALPHABLENDENABLE, false );
+    pDevice->SetRenderState( D3DRS_ALPHATESTENABLE, false );
   }
 
   //////////////////////////////////////////////////////////////////////////
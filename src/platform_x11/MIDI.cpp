@@ -1,6 +1,168 @@
-// Dummy midi implementation, just to make sure bonzomatic compiles.
 #include "../MIDI.h"
 
+#ifdef __linux__
+
+#include <stdio.h>
+#include <poll.h>
+#include <thread>
+#include <vector>
+#include <alsa/asoundlib.h>
+#include "../Timer.h"
+
+// ALSA sequencer input: one "Bonzomatic" client with a writable port, so
+// anything can be routed to it (aconnect, a DAW, a virmidi loopback);
+// every hardware / application output present at startup, or plugged in
+// later, gets connected automatically.
+namespace MIDI
+{
+  snd_seq_t * pSeq = NULL;
+  int nPort = -1;
+  std::thread inputThread;
+  std::atomic<bool> bRunning( false );
+  EventQueue queue;
+
+  void ConnectToSource( int nClient, int nSourcePort, unsigned int nCaps, unsigned int nType )
+  {
+    if (nClient == SND_SEQ_CLIENT_SYSTEM || nClient == snd_seq_client_id( pSeq ))
+      return;
+    if ((nCaps & (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ)) != (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ))
+      return;
+    if (!(nType & (SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_HARDWARE | SND_SEQ_PORT_TYPE_APPLICATION)))
+      return;
+    if (snd_seq_connect_from( pSeq, nPort, nClient, nSourcePort ) == 0)
+      printf("[MIDI] Listening to %d:%d\n", nClient, nSourcePort);
+  }
+
+  void ConnectToAllSources()
+  {
+    snd_seq_client_info_t * clientInfo;
+    snd_seq_port_info_t * portInfo;
+    snd_seq_client_info_alloca( &clientInfo );
+    snd_seq_port_info_alloca( &portInfo );
+
+    snd_seq_client_info_set_client( clientInfo, -1 );
+    while (snd_seq_query_next_client( pSeq, clientInfo ) >= 0)
+    {
+      int nClient = snd_seq_client_info_get_client( clientInfo );
+      snd_seq_port_info_set_client( portInfo, nClient );
+      snd_seq_port_info_set_port( portInfo, -1 );
+      while (snd_seq_query_next_port( pSeq, portInfo ) >= 0)
+        ConnectToSource( nClient, snd_seq_port_info_get_port( portInfo ), snd_seq_port_info_get_capability( portInfo ), snd_seq_port_info_get_type( portInfo ) );
+    }
+  }
+
+  void HandleEvent( const snd_seq_event_t * ev )
+  {
+    Event e;
+    e.nTime = Timer::GetTimeNS();
+    e.nChannel = ev->data.note.channel & 0x0F;
+    switch (ev->type)
+    {
+      case SND_SEQ_EVENT_NOTEON:
+        e.nType = MIDIMSG_NOTE_ON;
+        e.nData1 = ev->data.note.note;
+        e.nData2 = ev->data.note.velocity;
+        break;
+      case SND_SEQ_EVENT_NOTEOFF:
+        e.nType = MIDIMSG_NOTE_OFF;
+        e.nData1 = ev->data.note.note;
+        e.nData2 = ev->data.note.velocity;
+        break;
+      case SND_SEQ_EVENT_CONTROLLER:
+        e.nType = MIDIMSG_CONTROL_CHANGE;
+        e.nChannel = ev->data.control.channel & 0x0F;
+        e.nData1 = ev->data.control.param & 0x7F;
+        e.nData2 = ev->data.control.value & 0x7F;
+        break;
+      case SND_SEQ_EVENT_PITCHBEND:
+        {
+          // ALSA centers it on 0, on the wire it's 14 bits centered on 8192
+          int nValue = ev->data.control.value + 8192;
+          e.nType = MIDIMSG_PITCH_BEND;
+          e.nChannel = ev->data.control.channel & 0x0F;
+          e.nData1 = nValue & 0x7F;
+          e.nData2 = (nValue >> 7) & 0x7F;
+        } break;
+      case SND_SEQ_EVENT_PORT_START:
+        {
+          snd_seq_port_info_t * portInfo;
+          snd_seq_port_info_alloca( &portInfo );
+          if (snd_seq_get_any_port_info( pSeq, ev->data.addr.client, ev->data.addr.port, portInfo ) == 0)
+            ConnectToSource( ev->data.addr.client, ev->data.addr.port, snd_seq_port_info_get_capability( portInfo ), snd_seq_port_info_get_type( portInfo ) );
+        } return;
+      default:
+        return;
+    }
+    queue.Push( e );
+  }
+
+  void InputThread()
+  {
+    int nFDs = snd_seq_poll_descriptors_count( pSeq, POLLIN );
+    std::vector<struct pollfd> fds( nFDs );
+    snd_seq_poll_descriptors( pSeq, &fds[0], nFDs, POLLIN );
+
+    while (bRunning)
+    {
+      // the timeout is only there to notice Close()
+      if (poll( &fds[0], nFDs, 100 ) <= 0)
+        continue;
+
+      snd_seq_event_t * ev = NULL;
+      while (snd_seq_event_input( pSeq, &ev ) >= 0 && ev)
+        HandleEvent( ev );
+    }
+  }
+
+  bool Open()
+  {
+    if (snd_seq_open( &pSeq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK ) < 0)
+    {
+      printf("[MIDI] Cannot open the ALSA sequencer\n");
+      pSeq = NULL;
+      return false;
+    }
+    snd_seq_set_client_name( pSeq, "Bonzomatic" );
+
+    nPort = snd_seq_create_simple_port( pSeq, "Bonzomatic MIDI In",
+      SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+      SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION );
+    if (nPort < 0)
+    {
+      printf("[MIDI] Cannot create the ALSA sequencer port\n");
+      snd_seq_close( pSeq );
+      pSeq = NULL;
+      return false;
+    }
+
+    // announcements tell us about devices plugged in later
+    snd_seq_connect_from( pSeq, nPort, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE );
+    ConnectToAllSources();
+    printf("[MIDI] Input port is %d:%d\n", snd_seq_client_id( pSeq ), nPort);
+
+    AddQueue( &queue );
+    bRunning = true;
+    inputThread = std::thread( InputThread );
+    return true;
+  }
+
+  bool Close()
+  {
+    if (!pSeq)
+      return false;
+
+    bRunning = false;
+    inputThread.join();
+    RemoveQueues();
+    snd_seq_close( pSeq );
+    pSeq = NULL;
+    return true;
+  }
+}
+
+#else
+
+// no MIDI backend on this platform yet; the state stays at its defaults
 bool MIDI::Open() {
 	return false;
 }
@@ -9,6 +171,4 @@ bool MIDI::Close() {
 	return false;
 }
 
-float MIDI::GetCCValue( unsigned char cc) {
-	return 0.f;
-}
+#endif
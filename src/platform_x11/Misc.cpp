@@ -5,6 +5,10 @@
 #include "../Misc.h"
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
 
 void Misc::PlatformStartup()
 {
@@ -34,6 +38,43 @@ bool Misc::FileExists(const char * path)
   return access(path, R_OK) != -1;
 }
 
+const void * Misc::MapFile(const char * path, size_t & size)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  void * data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    size = st.st_size;
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd); // the mapping stays valid
+  return data == MAP_FAILED ? NULL : data;
+}
+
+void Misc::UnmapFile(const void * data, size_t size)
+{
+  munmap((void *)data, size);
+}
+
+bool Misc::GetFileStamp(const char * path, unsigned long long & size, unsigned long long & modified)
+{
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return false;
+  size = st.st_size;
+  modified = st.st_mtime;
+  return true;
+}
+
+bool Misc::MakeDirectory(const char * path)
+{
+  return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
 const char * Misc::GetDefaultFontPath()
 {
   // Linux case
@@ -26,13 +26,15 @@ namespace Timer
     clock_gettime(CLOCK_MONOTONIC, &startTime);
   }
 
-  float GetTime()
+  unsigned long long GetTimeNS()
   {
     timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
-    ts.tv_sec -= startTime.tv_sec;
-    ts.tv_nsec -= startTime.tv_nsec;
-    double now = ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
-    return now;
+    return (ts.tv_sec - startTime.tv_sec) * 1000000000ll + (ts.tv_nsec - startTime.tv_nsec);
+  }
+
+  double GetTime()
+  {
+    return GetTimeNS() / 1000000.0;
   }
 }